@@ -0,0 +1,5 @@
+g++ -O3 fiya-scope-bench.cpp ../fiya-heap-overloads.cpp -o fiya-scope-bench
+g++ -O3 -pthread fiya-heap-scaling-bench.cpp -o fiya-heap-scaling-bench-baseline
+g++ -O3 -pthread -DFIYA_BENCH_WITH_HEAP fiya-heap-scaling-bench.cpp ../fiya-heap-overloads.cpp -o fiya-heap-scaling-bench
+g++ -O3 fiya-export-bench.cpp -o fiya-export-bench
+g++ -O3 fiya-string-db-bench.cpp -o fiya-string-db-bench
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <chrono>
+#include <vector>
+#include <string>
+#include <ostream>
+#include <algorithm>
+
+/** Helpers shared by the FIYA benchmarks. Not part of the library. */
+namespace fiya_bench {
+
+/** Statistics of the samples, in nanoseconds per operation */
+struct stats_t {
+    double mean;
+    double median;
+    double p90;
+    double p99;
+    double min;
+    double max;
+};
+
+/** Calculates the statistics of @samples */
+inline stats_t calculate_stats(std::vector<double> samples) {
+    stats_t result {};
+    if (samples.empty()) {
+        return result;
+    }
+
+    std::sort(samples.begin(), samples.end());
+    double sum = 0.0;
+    for (double s: samples) {
+        sum += s;
+    }
+
+    auto percentile = [&samples] (double p) {
+        size_t idx = static_cast<size_t>(p * (samples.size() - 1) + 0.5);
+        return samples[idx];
+    };
+
+    result.mean = sum / samples.size();
+    result.median = percentile(0.5);
+    result.p90 = percentile(0.9);
+    result.p99 = percentile(0.99);
+    result.min = samples.front();
+    result.max = samples.back();
+    return result;
+}
+
+/** @brief Runs @op in @samples batches of @batch calls and returns the
+ *         nanoseconds per call of each batch.
+ */
+template <typename Operation>
+std::vector<double> sample_ns_per_op(size_t samples, size_t batch, const Operation& op) {
+    std::vector<double> result;
+    result.reserve(samples);
+
+    for (size_t s = 0; s < samples; s++) {
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < batch; i++) {
+            op(i);
+        }
+        auto end = std::chrono::steady_clock::now();
+        result.push_back(std::chrono::duration<double, std::nano>(end - start).count() / batch);
+    }
+
+    return result;
+}
+
+/** @brief Writes one JSON object per line. The caller writes the
+ *         benchmark specific fields in @fields, e.g. "\"label\":\"int\"".
+ */
+inline void write_json(std::ostream& os, const std::string& fields, const stats_t& stats) {
+    os << "{" << fields <<
+        ",\"ns_mean\":" << stats.mean <<
+        ",\"ns_median\":" << stats.median <<
+        ",\"ns_p90\":" << stats.p90 <<
+        ",\"ns_p99\":" << stats.p99 <<
+        ",\"ns_min\":" << stats.min <<
+        ",\"ns_max\":" << stats.max << "}";
+}
+
+}
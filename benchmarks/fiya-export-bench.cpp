@@ -0,0 +1,154 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <chrono>
+#include <memory>
+#include <cstdlib>
+#include <cstring>
+
+#include "../fiya-recorder.h"
+#include "fiya-synthetic-tree.h"
+
+/** Benchmark of the operations on the whole tree: teardown, collapsed
+ *  stack export, report generation and merging, on synthetic trees.
+ *  Prints one JSON object per phase with the wall time and the peak
+ *  memory (VmHWM) reached during the phase.
+ *
+ *  Usage: fiya-export-bench [--nodes N] [--fanout F] [--root-fanout F]
+ *                           [--depth D] [--descend P] [--label int|string|pointer]
+ */
+
+using namespace fiya;
+using namespace fiya_bench;
+
+/** Stream buffer that discards the output, but counts the bytes. */
+class counting_streambuf_t: public std::streambuf {
+public:
+    size_t bytes = 0;
+protected:
+    int_type overflow(int_type c) override {
+        bytes++;
+        return c;
+    }
+
+    std::streamsize xsputn(const char *, std::streamsize n) override {
+        bytes += static_cast<size_t>(n);
+        return n;
+    }
+};
+
+/** Returns a field from /proc/self/status in kB, or 0 if not available. */
+static size_t read_status_kb(const char * field) {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    size_t field_len = strlen(field);
+    while (std::getline(status, line)) {
+        if (line.compare(0, field_len, field) == 0) {
+            return static_cast<size_t>(atol(line.c_str() + field_len + 1));
+        }
+    }
+    return 0;
+}
+
+/** Resets the peak memory (VmHWM) to the current memory usage. */
+static void reset_peak_memory() {
+    std::ofstream clear_refs("/proc/self/clear_refs");
+    clear_refs << "5";
+}
+
+/** Runs one phase and prints its wall time and memory use. */
+template <typename Operation>
+static void run_phase(const char * phase, const std::string& config, const Operation& op) {
+    reset_peak_memory();
+    size_t rss_before = read_status_kb("VmRSS:");
+    auto start = std::chrono::steady_clock::now();
+    std::string extra = op();
+    auto end = std::chrono::steady_clock::now();
+
+    std::cout << "{" << config << ",\"phase\":\"" << phase << "\"" <<
+        ",\"ms\":" << std::chrono::duration<double, std::milli>(end - start).count() <<
+        ",\"rss_before_kb\":" << rss_before <<
+        ",\"peak_rss_kb\":" << read_status_kb("VmHWM:") << extra << "}" << std::endl;
+}
+
+template <typename LabelType>
+static void run(const tree_options_t& options) {
+    using recorder_type = recorder_t<LabelType, uint64_t>;
+
+    std::ostringstream config;
+    config << "\"label\":\"" << synthetic_label<LabelType>::name() << "\",\"nodes\":" << options.node_count <<
+        ",\"fanout\":" << options.fanout << ",\"root_fanout\":" << options.root_fanout << ",\"max_depth\":" << options.max_depth <<
+        ",\"descend_probability\":" << options.descend_probability;
+
+    std::unique_ptr<recorder_type> recorder(new recorder_type(0ULL, synthetic_label<LabelType>::get(0), 0ULL));
+    std::unique_ptr<recorder_type> other(new recorder_type(0ULL, synthetic_label<LabelType>::get(0), 0ULL));
+
+    run_phase("generate", config.str(), [&] {
+        size_t created = synthetic_tree_generator_t<LabelType, uint64_t>(options).generate(*recorder);
+        return ",\"created\":" + std::to_string(created);
+    });
+
+    auto label_out = [] (std::ostream& os, const LabelType& l) {
+        os << l;
+    };
+    auto value_out = [] (std::ostream& os, const uint64_t& m) {
+        os << m;
+    };
+
+    run_phase("to_collapsed_stacks", config.str(), [&] {
+        counting_streambuf_t buffer;
+        std::ostream os(&buffer);
+        recorder->to_collapsed_stacks(os, label_out, value_out);
+        return ",\"bytes\":" + std::to_string(buffer.bytes);
+    });
+
+    run_phase("to_report", config.str(), [&] {
+        auto report = recorder->to_report();
+        return ",\"labels\":" + std::to_string(report.report.size());
+    });
+
+    /* A tree with a different seed has a partially overlapping shape */
+    tree_options_t other_options = options;
+    other_options.seed = options.seed + 1;
+    synthetic_tree_generator_t<LabelType, uint64_t>(other_options).generate(*other);
+
+    run_phase("merge", config.str(), [&] {
+        recorder->merge(*other);
+        return std::string();
+    });
+
+    run_phase("teardown", config.str(), [&] {
+        recorder.reset();
+        return std::string();
+    });
+}
+
+int main(int argc, char **argv) {
+    tree_options_t options;
+    std::string label = "int";
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--nodes") == 0) {
+            options.node_count = static_cast<size_t>(atol(argv[i + 1]));
+        } else if (strcmp(argv[i], "--fanout") == 0) {
+            options.fanout = static_cast<size_t>(std::max(1, atoi(argv[i + 1])));
+        } else if (strcmp(argv[i], "--root-fanout") == 0) {
+            options.root_fanout = static_cast<size_t>(std::max(1, atoi(argv[i + 1])));
+        } else if (strcmp(argv[i], "--depth") == 0) {
+            options.max_depth = static_cast<size_t>(std::max(1, atoi(argv[i + 1])));
+        } else if (strcmp(argv[i], "--descend") == 0) {
+            options.descend_probability = atof(argv[i + 1]);
+        } else if (strcmp(argv[i], "--label") == 0) {
+            label = argv[i + 1];
+        }
+    }
+
+    if (label == "string") {
+        run<const char*>(options);
+    } else if (label == "pointer") {
+        run<void*>(options);
+    } else {
+        run<int>(options);
+    }
+}
@@ -0,0 +1,280 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef FIYA_BENCH_WITH_HEAP
+#include "../fiya-heap-measure.h"
+#endif
+
+/** Benchmark of operator new/delete scaling with the number of threads.
+ *
+ *  Build it twice (see compile.sh): without FIYA, which is the baseline,
+ *  and with -DFIYA_BENCH_WITH_HEAP and fiya-heap-overloads.cpp linked.
+ *  The FIYA build runs two heap accounting modes:
+ *    - "overloads": operator new/delete are FIYA's, but get_heap_counter()
+ *                   returns nullptr, so nothing is accounted
+ *    - "accounting": every thread accounts into its own recorder
+ *
+ *  Prints one JSON object per line. Pass the output of the baseline
+ *  build with --baseline <file> to get the overhead ratios.
+ *
+ *  Usage: fiya-heap-scaling-bench [--threads N] [--baseline file]
+ */
+
+#ifdef FIYA_BENCH_WITH_HEAP
+using namespace fiya;
+
+/** Each thread accounts into its own recorder */
+thread_local measure_heap_t<int>::recorder_type heap_recorder(heap_usage_t{}, 0, heap_usage_t{});
+
+/** Selected by the benchmark, see the modes above */
+static std::atomic<bool> accounting_enabled { false };
+
+fiya::counter_interface_t<fiya::heap_usage_t> * get_heap_counter() {
+    if (!accounting_enabled.load(std::memory_order_relaxed)) {
+        return nullptr;
+    }
+    return &heap_recorder;
+}
+#endif
+
+/** Small pseudo random generator, so the sizes don't depend on libc's rand() */
+struct xorshift_t {
+    uint64_t state;
+
+    uint64_t next() {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    }
+};
+
+/** Allocation workload description */
+struct workload_t {
+    const char * name;
+    size_t min_size;
+    size_t max_size;
+    /** Allocations done by each thread (or each producer) */
+    size_t operations;
+    bool cross_thread;
+};
+
+/** Objects kept alive at once by the same thread workload */
+static constexpr size_t BATCH { 64U };
+
+/** Allocates and frees in the same thread. */
+static void same_thread_worker(const workload_t& w, uint64_t seed) {
+    xorshift_t rng { seed };
+    char * objects[BATCH];
+
+    for (size_t done = 0; done < w.operations; done += BATCH) {
+        for (size_t i = 0; i < BATCH; i++) {
+            size_t size = w.min_size + rng.next() % (w.max_size - w.min_size + 1);
+            objects[i] = new char[size];
+            objects[i][0] = 1;
+        }
+        for (size_t i = 0; i < BATCH; i++) {
+            delete[] objects[i];
+        }
+    }
+}
+
+/** Single producer, single consumer queue used by the cross-thread workload. */
+class spsc_queue_t {
+public:
+    bool push(char * p) {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        if (head - m_tail.load(std::memory_order_acquire) == CAPACITY) {
+            return false;
+        }
+        m_items[head % CAPACITY] = p;
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    char * pop() {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail == m_head.load(std::memory_order_acquire)) {
+            return nullptr;
+        }
+        char * p = m_items[tail % CAPACITY];
+        m_tail.store(tail + 1, std::memory_order_release);
+        return p;
+    }
+private:
+    static constexpr size_t CAPACITY { 1024U };
+    char * m_items[CAPACITY];
+    alignas(64) std::atomic<size_t> m_head { 0U };
+    alignas(64) std::atomic<size_t> m_tail { 0U };
+};
+
+/** Allocates in one thread and frees in another. */
+static void producer_worker(const workload_t& w, uint64_t seed, spsc_queue_t& queue) {
+    xorshift_t rng { seed };
+    for (size_t done = 0; done < w.operations; done++) {
+        size_t size = w.min_size + rng.next() % (w.max_size - w.min_size + 1);
+        char * p = new char[size];
+        p[0] = 1;
+        while (!queue.push(p)) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+static void consumer_worker(const workload_t& w, spsc_queue_t& queue) {
+    for (size_t done = 0; done < w.operations; ) {
+        char * p = queue.pop();
+        if (p) {
+            delete[] p;
+            done++;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+}
+
+/** Runs the workload on @threads threads and returns allocations per second. */
+static double run(const workload_t& w, size_t threads) {
+    std::vector<std::thread> workers;
+    std::vector<spsc_queue_t> queues(w.cross_thread ? threads / 2 : 0);
+
+    auto start = std::chrono::steady_clock::now();
+    if (w.cross_thread) {
+        for (size_t i = 0; i < queues.size(); i++) {
+            workers.emplace_back(producer_worker, std::cref(w), 0x9e3779b97f4a7c15ULL + i, std::ref(queues[i]));
+            workers.emplace_back(consumer_worker, std::cref(w), std::ref(queues[i]));
+        }
+    } else {
+        for (size_t i = 0; i < threads; i++) {
+            workers.emplace_back(same_thread_worker, std::cref(w), 0x9e3779b97f4a7c15ULL + i);
+        }
+    }
+    for (std::thread& t: workers) {
+        t.join();
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    size_t allocating_threads = w.cross_thread ? queues.size() : threads;
+    double seconds = std::chrono::duration<double>(end - start).count();
+    return static_cast<double>(w.operations * allocating_threads) / seconds;
+}
+
+/** Result of one configuration */
+struct result_t {
+    std::string mode;
+    std::string workload;
+    size_t threads;
+    double ops_per_sec;
+};
+
+/** Reads "ops_per_sec" of the baseline results written by this program */
+static std::vector<result_t> read_baseline(const char * file_name) {
+    std::vector<result_t> result;
+    std::ifstream file(file_name);
+    std::string line;
+
+    auto field = [] (const std::string& line, const char * name) {
+        std::string key = std::string("\"") + name + "\":";
+        size_t pos = line.find(key);
+        if (pos == std::string::npos) {
+            return std::string();
+        }
+        pos += key.size();
+        size_t end = line.find_first_of(",}", pos);
+        std::string value = line.substr(pos, end - pos);
+        if (!value.empty() && value.front() == '"') {
+            value = value.substr(1, value.size() - 2);
+        }
+        return value;
+    };
+
+    while (std::getline(file, line)) {
+        if (field(line, "mode") != "baseline") {
+            continue;
+        }
+        result_t r;
+        r.mode = "baseline";
+        r.workload = field(line, "workload");
+        r.threads = static_cast<size_t>(atol(field(line, "threads").c_str()));
+        r.ops_per_sec = atof(field(line, "ops_per_sec").c_str());
+        result.push_back(r);
+    }
+    return result;
+}
+
+/** Finds the result for the same workload and thread count */
+static const result_t * find(const std::vector<result_t>& results, const std::string& mode, const std::string& workload, size_t threads) {
+    for (const result_t& r: results) {
+        if (r.mode == mode && r.workload == workload && r.threads == threads) {
+            return &r;
+        }
+    }
+    return nullptr;
+}
+
+int main(int argc, char **argv) {
+    size_t max_threads = std::max(1U, std::thread::hardware_concurrency());
+    std::vector<result_t> baseline;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            max_threads = static_cast<size_t>(std::max(1, atoi(argv[++i])));
+        } else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) {
+            baseline = read_baseline(argv[++i]);
+        }
+    }
+
+    const workload_t workloads[] = {
+        { "small", 16, 128, 2000000, false },
+        { "large", 4096, 65536, 200000, false },
+        { "small_cross_thread", 16, 128, 1000000, true },
+        { "large_cross_thread", 4096, 65536, 100000, true },
+    };
+
+#ifdef FIYA_BENCH_WITH_HEAP
+    const char * modes[] = { "overloads", "accounting" };
+#else
+    const char * modes[] = { "baseline" };
+#endif
+
+    std::vector<result_t> results;
+    for (const char * mode: modes) {
+#ifdef FIYA_BENCH_WITH_HEAP
+        accounting_enabled = strcmp(mode, "accounting") == 0;
+#endif
+        for (const workload_t& w: workloads) {
+            for (size_t threads = w.cross_thread ? 2 : 1; threads <= max_threads; threads *= 2) {
+                result_t r { mode, w.name, threads, run(w, threads) };
+                results.push_back(r);
+
+                std::cout << "{\"mode\":\"" << r.mode << "\",\"workload\":\"" << r.workload <<
+                    "\",\"threads\":" << r.threads << ",\"ops_per_sec\":" << r.ops_per_sec;
+
+                /* Scaling efficiency: throughput relative to linear scaling of the
+                 * smallest thread count. With per-thread counters it should track
+                 * the baseline; a drop indicates contention or false sharing.
+                 */
+                const result_t * first = find(results, r.mode, r.workload, w.cross_thread ? 2 : 1);
+                double efficiency = r.ops_per_sec / (first->ops_per_sec * r.threads / first->threads);
+                std::cout << ",\"scaling_efficiency\":" << efficiency;
+
+                const result_t * base = find(baseline, "baseline", r.workload, r.threads);
+                const result_t * base_first = find(baseline, "baseline", r.workload, first->threads);
+                if (base && base_first) {
+                    double base_efficiency = base->ops_per_sec / (base_first->ops_per_sec * r.threads / first->threads);
+                    std::cout << ",\"overhead_ratio\":" << base->ops_per_sec / r.ops_per_sec <<
+                        ",\"scaling_warning\":" << (efficiency < 0.8 * base_efficiency ? "true" : "false");
+                }
+                std::cout << "}" << std::endl;
+            }
+        }
+    }
+}
@@ -0,0 +1,237 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <time.h>
+
+#include "../fiya-time-measure.h"
+#include "../fiya-heap-measure.h"
+#include "fiya-bench-stats.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define FIYA_BENCH_HAS_RDTSC
+#endif
+
+/** Benchmark of the scope transition overhead. Prints a JSON array
+ *  with one object per configuration, nanoseconds per scope (a
+ *  begin_scope/end_scope pair, or one RAII wrapper).
+ *
+ *  Usage: fiya-scope-bench [samples]
+ */
+
+using namespace fiya;
+using namespace fiya_bench;
+
+/** Label enum used in the benchmark. Values are casted from int. */
+enum class bench_label_e : int {
+    root
+};
+
+/** Recorder used by measure_heap_t; fiya-heap-overloads.cpp needs it */
+thread_local measure_heap_t<int>::recorder_type heap_recorder(heap_usage_t{}, 0, heap_usage_t{});
+
+fiya::counter_interface_t<fiya::heap_usage_t> * get_heap_counter() {
+    return &heap_recorder;
+}
+
+/** Calls per sample. */
+static constexpr size_t BATCH { 10000U };
+
+/** Number of samples, can be changed from the command line. */
+static size_t samples { 200U };
+
+/** Separator between JSON objects */
+static const char * separator = "";
+
+/** Prints the result of one configuration */
+static void report(const std::string& fields, const std::vector<double>& ns) {
+    std::cout << separator << "\n  ";
+    write_json(std::cout, fields, calculate_stats(ns));
+    separator = ",";
+}
+
+/** Creates @count distinct labels of the given type. The strings
+ *  backing const char* labels are kept in @storage.
+ */
+template <typename LabelType>
+struct label_factory;
+
+template <>
+struct label_factory<bench_label_e> {
+    static const char * name() { return "enum"; }
+    static std::vector<bench_label_e> create(size_t count, std::vector<std::string>&) {
+        std::vector<bench_label_e> result;
+        for (size_t i = 0; i < count; i++) {
+            result.push_back(static_cast<bench_label_e>(i + 1));
+        }
+        return result;
+    }
+};
+
+template <>
+struct label_factory<int> {
+    static const char * name() { return "int"; }
+    static std::vector<int> create(size_t count, std::vector<std::string>&) {
+        std::vector<int> result;
+        for (size_t i = 0; i < count; i++) {
+            result.push_back(static_cast<int>(i + 1));
+        }
+        return result;
+    }
+};
+
+template <>
+struct label_factory<const char*> {
+    static const char * name() { return "const char*"; }
+    static std::vector<const char*> create(size_t count, std::vector<std::string>& storage) {
+        /* Function-like names, with a common prefix as in real code */
+        storage.clear();
+        for (size_t i = 0; i < count; i++) {
+            storage.push_back("my_namespace::my_component::function_" + std::to_string(i));
+        }
+        std::vector<const char*> result;
+        for (const std::string& s: storage) {
+            result.push_back(s.c_str());
+        }
+        return result;
+    }
+};
+
+template <>
+struct label_factory<void*> {
+    static const char * name() { return "void*"; }
+    static std::vector<void*> create(size_t count, std::vector<std::string>&) {
+        std::vector<void*> result;
+        for (size_t i = 0; i < count; i++) {
+            result.push_back(reinterpret_cast<void*>(0x400000 + i * 64));
+        }
+        return result;
+    }
+};
+
+/** @brief Measures begin_scope/end_scope pairs at @depth, cycling through @fanout
+ *         sibling labels, so the lookup in the parent's children is exercised.
+ */
+template <typename LabelType>
+void bench_scope_pair(size_t fanout, size_t depth) {
+    std::vector<std::string> storage;
+    std::vector<LabelType> labels = label_factory<LabelType>::create(fanout + depth, storage);
+    recorder_t<LabelType, uint64_t> recorder(0ULL, labels[fanout], 0ULL);
+
+    /* Open the scopes above the measured one */
+    for (size_t d = 1; d < depth; d++) {
+        recorder.begin_scope(labels[fanout + d]);
+    }
+    /* Create the children so we measure lookups, not allocations */
+    for (size_t i = 0; i < fanout; i++) {
+        recorder.begin_scope(labels[i]);
+        recorder.end_scope();
+    }
+
+    std::vector<double> ns = sample_ns_per_op(samples, BATCH, [&] (size_t i) {
+        recorder.begin_scope(labels[i % fanout]);
+        recorder.end_scope();
+    });
+
+    std::ostringstream fields;
+    fields << "\"benchmark\":\"scope_pair\",\"label\":\"" << label_factory<LabelType>::name() <<
+        "\",\"fanout\":" << fanout << ",\"depth\":" << depth;
+    report(fields.str(), ns);
+}
+
+/** @brief Measures measure_time_t scopes, i.e. the scope pair plus four clock reads. */
+template <typename LabelType>
+void bench_measure_time(size_t fanout) {
+    std::vector<std::string> storage;
+    std::vector<LabelType> labels = label_factory<LabelType>::create(fanout + 1, storage);
+    typename measure_time_t<LabelType>::recorder_type recorder({}, labels[fanout], time_value_t::now());
+
+    std::vector<double> ns = sample_ns_per_op(samples, BATCH, [&] (size_t i) {
+        measure_time_t<LabelType> m(labels[i % fanout], &recorder);
+    });
+
+    std::ostringstream fields;
+    fields << "\"benchmark\":\"measure_time_t\",\"label\":\"" << label_factory<LabelType>::name() <<
+        "\",\"fanout\":" << fanout << ",\"depth\":1";
+    report(fields.str(), ns);
+}
+
+/** @brief Measures measure_heap_t scopes. */
+void bench_measure_heap(size_t fanout) {
+    std::vector<std::string> storage;
+    std::vector<int> labels = label_factory<int>::create(fanout, storage);
+
+    std::vector<double> ns = sample_ns_per_op(samples, BATCH, [&] (size_t i) {
+        measure_heap_t<int> m(labels[i % fanout], &heap_recorder);
+    });
+
+    std::ostringstream fields;
+    fields << "\"benchmark\":\"measure_heap_t\",\"label\":\"int\",\"fanout\":" << fanout << ",\"depth\":1";
+    report(fields.str(), ns);
+}
+
+/** @brief Measures one read of a clock source. */
+template <typename Clock>
+void bench_clock(const char * name, const Clock& clock) {
+    volatile uint64_t sink = 0;
+    std::vector<double> ns = sample_ns_per_op(samples, BATCH, [&] (size_t) {
+        sink = sink + clock();
+    });
+
+    std::ostringstream fields;
+    fields << "\"benchmark\":\"clock\",\"clock\":\"" << name << "\"";
+    report(fields.str(), ns);
+}
+
+/** Returns the value of a POSIX clock in nanoseconds */
+static uint64_t posix_clock_ns(clockid_t id) {
+    struct timespec ts;
+    clock_gettime(id, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1) {
+        samples = static_cast<size_t>(std::max(1, atoi(argv[1])));
+    }
+
+    const size_t fanouts[] = { 1, 10, 100, 1000 };
+    const size_t depths[] = { 1, 8, 64 };
+
+    std::cout << "[";
+
+    for (size_t fanout: fanouts) {
+        for (size_t depth: depths) {
+            bench_scope_pair<bench_label_e>(fanout, depth);
+            bench_scope_pair<int>(fanout, depth);
+            bench_scope_pair<const char*>(fanout, depth);
+            bench_scope_pair<void*>(fanout, depth);
+        }
+    }
+
+    for (size_t fanout: fanouts) {
+        bench_measure_time<bench_label_e>(fanout);
+        bench_measure_time<int>(fanout);
+        bench_measure_time<const char*>(fanout);
+        bench_measure_time<void*>(fanout);
+        bench_measure_heap(fanout);
+    }
+
+    bench_clock("CLOCK_THREAD_CPUTIME_ID", [] { return posix_clock_ns(CLOCK_THREAD_CPUTIME_ID); });
+    bench_clock("CLOCK_MONOTONIC", [] { return posix_clock_ns(CLOCK_MONOTONIC); });
+    bench_clock("CLOCK_MONOTONIC_COARSE", [] { return posix_clock_ns(CLOCK_MONOTONIC_COARSE); });
+    bench_clock("std::chrono::steady_clock", [] {
+        return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+    });
+    bench_clock("fiya::get_thread_time", [] {
+        return static_cast<uint64_t>(get_thread_time<void>().time_since_epoch().count());
+    });
+#ifdef FIYA_BENCH_HAS_RDTSC
+    bench_clock("rdtsc", [] { return static_cast<uint64_t>(__rdtsc()); });
+#endif
+
+    std::cout << "\n]\n";
+}
@@ -0,0 +1,179 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+#include "../fiya-string-db.h"
+
+/** Benchmark of string_db_t, the storage behind const char* labels.
+ *  Uses long, realistic demangled C++ symbol names. Prints one JSON
+ *  object per line:
+ *    - "growth": memory and insert time while the database grows,
+ *      including the std::unordered_set nodes and buckets
+ *    - "intern_miss", "intern_hit": throughput of push_back for new
+ *      and for already interned strings
+ *
+ *  Usage: fiya-string-db-bench [strings]
+ */
+
+using namespace fiya;
+
+/** Bytes allocated through operator new by string_db_t, i.e. by its std::unordered_set */
+static size_t new_bytes = 0;
+/** True while string_db_t is called, only then are the allocations counted */
+static bool count_new = false;
+
+/* Kept out of line: inlined into the callers, the size header in front of
+ * the block looks like an out of bounds access and a mismatched free.
+ */
+__attribute__((noinline)) void * operator new(std::size_t n) {
+    /* Keep the size in front of the block, so operator delete can subtract it */
+    size_t * p = reinterpret_cast<size_t*>(malloc(n + sizeof(size_t) * 2));
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    p[0] = count_new ? n : 0;
+    new_bytes += p[0];
+    return p + 2;
+}
+
+__attribute__((noinline)) void operator delete(void * p) noexcept {
+    if (p) {
+        size_t * block = reinterpret_cast<size_t*>(p) - 2;
+        new_bytes -= block[0];
+        free(block);
+    }
+}
+
+void operator delete(void * p, std::size_t) noexcept {
+    operator delete(p);
+}
+
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+/** The heap figure includes the string data */
+static const bool heap_complete = true;
+#else
+/** The heap figure is only the operator new bytes, without the string data */
+static const bool heap_complete = false;
+#endif
+
+/** Returns the bytes in use by malloc, which includes the string data
+ *  and malloc's own overhead. Large blocks are served by mmap and
+ *  counted separately. Falls back to the operator new bytes, see
+ *  heap_complete.
+ */
+static size_t heap_in_use() {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+#else
+    return new_bytes;
+#endif
+}
+
+/** Generates unique demangled-looking C++ symbol names */
+static std::vector<std::string> generate_symbols(size_t count) {
+    static const char * namespaces[] = { "std", "boost::asio::detail", "app::storage", "app::net::http", "absl::lts_20230802" };
+    static const char * classes[] = { "vector", "basic_string", "unordered_map", "shared_ptr", "function", "variant" };
+    static const char * args[] = {
+        "std::basic_string<char, std::char_traits<char>, std::allocator<char> >",
+        "int const&",
+        "std::pair<unsigned long const, std::shared_ptr<app::storage::page_t> >",
+        "std::chrono::duration<long, std::ratio<1l, 1000000000l> >",
+        "void (*)(void*)"
+    };
+    static const char * methods[] = { "_M_realloc_insert", "operator()", "emplace_back", "find", "~destructor", "process" };
+
+    std::vector<std::string> result;
+    result.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        std::string s;
+        s += namespaces[i % 5];
+        s += "::";
+        s += classes[(i / 5) % 6];
+        s += "<";
+        s += args[(i / 30) % 5];
+        s += ", std::allocator<";
+        s += args[(i / 150) % 5];
+        s += "> >::";
+        s += methods[(i / 750) % 6];
+        s += "_";
+        s += std::to_string(i);
+        s += "(";
+        s += args[(i / 7) % 5];
+        s += ")";
+        result.push_back(std::move(s));
+    }
+    return result;
+}
+
+int main(int argc, char **argv) {
+    size_t count = argc > 1 ? static_cast<size_t>(atol(argv[1])) : 1000000;
+    std::vector<std::string> symbols = generate_symbols(count);
+
+    size_t payload = 0;
+    size_t heap_before = heap_in_use();
+    size_t new_before = new_bytes;
+
+    count_new = true;
+    string_db_t* db = new string_db_t();
+    count_new = false;
+    size_t next_report = 1;
+    auto start = std::chrono::steady_clock::now();
+    auto interval_start = start;
+    size_t interval_first = 0;
+
+    /* Growth and miss throughput */
+    for (size_t i = 0; i < count; i++) {
+        count_new = true;
+        db->push_back(symbols[i].c_str());
+        count_new = false;
+        payload += symbols[i].size() + 1;
+
+        if (i + 1 == next_report || i + 1 == count) {
+            auto now = std::chrono::steady_clock::now();
+            size_t strings = i + 1;
+            size_t heap = heap_in_use() - heap_before;
+            size_t dict = new_bytes - new_before;
+            double ns = std::chrono::duration<double, std::nano>(now - interval_start).count() / (strings - interval_first);
+
+            std::cout << "{\"benchmark\":\"growth\",\"strings\":" << strings <<
+                ",\"payload_bytes\":" << payload <<
+                ",\"heap_bytes\":" << heap <<
+                ",\"unordered_set_bytes\":" << dict;
+            /* Without the string data in the heap figure, the difference is meaningless */
+            if (heap_complete) {
+                std::cout << ",\"overhead_bytes_per_string\":" <<
+                    (static_cast<double>(heap) - static_cast<double>(payload)) / strings;
+            }
+            std::cout << ",\"ns_per_insert\":" << ns << "}" << std::endl;
+
+            interval_start = now;
+            interval_first = strings;
+            next_report *= 4;
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    std::cout << "{\"benchmark\":\"intern_miss\",\"strings\":" << count <<
+        ",\"ns_per_op\":" << std::chrono::duration<double, std::nano>(end - start).count() / count << "}" << std::endl;
+
+    /* Hit throughput, in a different order than inserted */
+    size_t checksum = 0;
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < count; i++) {
+        size_t idx = (i * 2654435761ULL) % count;
+        checksum += db->push_back(symbols[idx].c_str());
+    }
+    end = std::chrono::steady_clock::now();
+    std::cout << "{\"benchmark\":\"intern_hit\",\"strings\":" << count <<
+        ",\"ns_per_op\":" << std::chrono::duration<double, std::nano>(end - start).count() / count <<
+        ",\"checksum\":" << checksum << "}" << std::endl;
+
+    delete db;
+}
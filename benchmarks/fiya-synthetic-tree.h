@@ -0,0 +1,172 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+#include "../fiya-recorder.h"
+
+/** Helpers shared by the FIYA benchmarks. Not part of the library. */
+namespace fiya_bench {
+
+/** Shape of the synthetic tree */
+struct tree_options_t {
+    /** Number of nodes to create, without the root */
+    size_t node_count = 100000;
+    /** Maximum number of children of a node below the root */
+    size_t fanout = 8;
+    /** Maximum number of children of the root */
+    size_t root_fanout = 1024;
+    /** Maximum depth of the tree */
+    size_t max_depth = 32;
+    /** Ratio of the number of nodes of consecutive depths: the depths are
+     *  geometrically distributed, the number of nodes at depth d is
+     *  proportional to descend_probability^(d - 1) up to max_depth. Lower
+     *  values give shallower trees. A depth that can't hold its share with
+     *  the fanout of the depth above, usually one of the first, passes the
+     *  rest to the next depth, or after the last one to the deepest depth
+     *  that has room.
+     */
+    double descend_probability = 0.6;
+    /** Seed of the random generator, trees with the same options and seed are equal */
+    uint64_t seed = 1;
+};
+
+/** @brief Returns the number of nodes at each depth, from 1 to max_depth,
+ *         of the trees generated with @options. Their sum is less than
+ *         node_count if the fanouts and the depth can't hold all the nodes.
+ */
+inline std::vector<size_t> depth_histogram(const tree_options_t& options) {
+    std::vector<double> cumulative(options.max_depth);
+    double weight = 1.0;
+    double sum = 0.0;
+    for (size_t d = 0; d < options.max_depth; d++) {
+        sum += weight;
+        cumulative[d] = sum;
+        weight *= options.descend_probability;
+    }
+
+    std::vector<size_t> histogram(options.max_depth);
+    size_t assigned = 0;
+    size_t carry = 0;
+    size_t capacity = options.root_fanout;
+    for (size_t d = 0; d < options.max_depth; d++) {
+        /* Rounding the cumulative share makes the depths sum up to node_count */
+        size_t until = static_cast<size_t>(static_cast<double>(options.node_count) * cumulative[d] / sum + 0.5);
+        size_t wanted = until - assigned + carry;
+        assigned = until;
+        histogram[d] = std::min(wanted, capacity);
+        carry = wanted - histogram[d];
+        capacity = histogram[d] * options.fanout;
+    }
+
+    /* Nodes left after the last depth with nodes go to the deepest depth that has room */
+    for (size_t d = options.max_depth; d > 0 && carry > 0; d--) {
+        capacity = (d == 1) ? options.root_fanout : histogram[d - 2] * options.fanout;
+        size_t added = std::min(carry, capacity - std::min(capacity, histogram[d - 1]));
+        histogram[d - 1] += added;
+        carry -= added;
+    }
+    return histogram;
+}
+
+/** Creates labels of different types from an index. */
+template <typename LabelType>
+struct synthetic_label;
+
+template <>
+struct synthetic_label<int> {
+    static const char * name() { return "int"; }
+    static int get(size_t idx) { return static_cast<int>(idx); }
+};
+
+template <>
+struct synthetic_label<void*> {
+    static const char * name() { return "void*"; }
+    static void* get(size_t idx) { return reinterpret_cast<void*>(0x400000 + idx * 16); }
+};
+
+template <>
+struct synthetic_label<const char*> {
+    static const char * name() { return "const char*"; }
+    static const char * get(size_t idx) {
+        /* Names look like C++ functions, so the string comparisons are realistic */
+        static std::vector<std::string> names;
+        while (names.size() <= idx) {
+            names.push_back("synthetic::component_" + std::to_string(names.size() % 97) +
+                "::function_" + std::to_string(names.size()));
+        }
+        return names[idx].c_str();
+    }
+};
+
+/** @brief Generates a synthetic tree in @recorder, adding random values to
+ *         the nodes. The shape is generated depth by depth, breadth-first,
+ *         with the number of nodes of depth_histogram: each node of a depth
+ *         is given to a random parent of the depth above that has less than
+ *         the fanout. Siblings get distinct labels, so every begin_scope
+ *         creates a new node.
+ */
+template <typename LabelType, typename MeasureType>
+class synthetic_tree_generator_t {
+public:
+    synthetic_tree_generator_t(const tree_options_t& options) :
+        m_options(options),
+        m_state(options.seed * 0x9e3779b97f4a7c15ULL + 1),
+        m_created(0)
+    { }
+
+    /** Generates the tree and returns the number of created nodes. */
+    size_t generate(fiya::recorder_t<LabelType, MeasureType>& recorder) {
+        std::vector<size_t> histogram = depth_histogram(m_options);
+
+        /* Number of children of each node, per depth; the root is depth 0 */
+        m_children.assign(1, std::vector<uint32_t>(1, 0));
+        for (size_t d = 0; d < histogram.size() && histogram[d] > 0; d++) {
+            std::vector<uint32_t>& parents = m_children.back();
+            size_t limit = (d == 0) ? m_options.root_fanout : m_options.fanout;
+            for (size_t i = 0; i < histogram[d]; i++) {
+                size_t parent = static_cast<size_t>(next() % parents.size());
+                while (parents[parent] >= limit) {
+                    parent = (parent + 1) % parents.size();
+                }
+                parents[parent]++;
+            }
+            m_children.emplace_back(histogram[d], 0);
+        }
+
+        /* The recorder is built through scopes, so the nodes are added depth-first */
+        m_next.assign(m_children.size(), 0);
+        add_children(recorder, 0, 0);
+        return m_created;
+    }
+private:
+    tree_options_t m_options;
+    uint64_t m_state;
+    size_t m_created;
+    /** Number of children of each node, per depth, in depth-first order */
+    std::vector<std::vector<uint32_t>> m_children;
+    /** Next node of each depth to add */
+    std::vector<size_t> m_next;
+
+    /** xorshift random generator */
+    uint64_t next() {
+        m_state ^= m_state << 13;
+        m_state ^= m_state >> 7;
+        m_state ^= m_state << 17;
+        return m_state;
+    }
+
+    void add_children(fiya::recorder_t<LabelType, MeasureType>& recorder, size_t depth, size_t node) {
+        for (size_t i = 0; i < m_children[depth][node]; i++) {
+            recorder.begin_scope(synthetic_label<LabelType>::get(i));
+            recorder.cnt() = recorder.cnt() + static_cast<MeasureType>(next() % 1000);
+            m_created++;
+            add_children(recorder, depth + 1, m_next[depth + 1]++);
+            recorder.end_scope();
+        }
+    }
+};
+
+}
@@ -1,3 +1,15 @@
 g++ -O0 fiya-time-measure.cpp -o fiya-time-measure
 g++ -O3 fiya-heap-measure.cpp ../fiya-heap-overloads.cpp -o fiya-heap-measure
 g++ -O3 -g -finstrument-functions -rdynamic -Wl,--export-dynamic fiya-cyg-time-measure.cpp ../fiya-cyg-overloads.cpp -o fiya-cyg-time-measure -ldl
+g++ -O3 fiya-io-measure.cpp ../fiya-io-overloads.cpp -o fiya-io-measure -ldl
+g++ -O3 fiya-perf-measure.cpp -o fiya-perf-measure
+g++ -O3 fiya-counters.cpp -o fiya-counters
+g++ -O3 fiya-stack-measure.cpp -o fiya-stack-measure
+g++ -O3 fiya-bench.cpp -o fiya-bench
+g++ -O3 fiya-sampling.cpp -o fiya-sampling
+g++ -O3 fiya-tail.cpp -o fiya-tail
+g++ -O3 fiya-budget.cpp -o fiya-budget
+g++ -O3 fiya-decay.cpp -o fiya-decay
+g++ -O1 -g -finstrument-functions -rdynamic fiya-startup.cpp ../fiya-startup-overloads.cpp -o fiya-startup -ldl
+g++ -O3 fiya-heatmap.cpp -o fiya-heatmap
+g++ -O3 fiya-gauges.cpp -o fiya-gauges -pthread
@@ -0,0 +1,61 @@
+#include <iostream>
+#include <fstream>
+#include "../fiya-bench.h"
+
+using namespace fiya;
+
+/** We specialize measure_time_t using const char* labels */
+using my_measure_time_t = measure_time_t<const char*>;
+
+/** Convenient function wrapper. The recorder is the one passed by bench_t. */
+#define MEASURE_FUNC(recorder) my_measure_time_t m(__FUNCTION__, recorder)
+
+/** We use this to busy wait in a function */
+void busy_wait(int64_t v) {
+    int64_t num = v * 10000;
+    while (num--) (void) rand();
+}
+
+/** The function we benchmark, and the functions it calls */
+void parse(bench_t<const char*>::recorder_type* recorder) {
+    MEASURE_FUNC(recorder);
+    busy_wait(5 + rand() % 5);
+}
+
+void validate(bench_t<const char*>::recorder_type* recorder) {
+    MEASURE_FUNC(recorder);
+    busy_wait(2);
+}
+
+void process(bench_t<const char*>::recorder_type* recorder) {
+    MEASURE_FUNC(recorder);
+    parse(recorder);
+    validate(recorder);
+    busy_wait(1);
+}
+
+const char * fileName = "fiya-bench.txt";
+
+int main(int argc, char **argv) {
+    bench_options_t options;
+    options.iterations = 50;
+    options.warmup = 5;
+
+    bench_t<const char*> bench("root", options);
+    bench.run([] (bench_t<const char*>::recorder_type* recorder) {
+        process(recorder);
+    });
+
+    auto label_out = [] (std::ostream& os, const char* const & l) {
+        os << l;
+    };
+
+    /** Per path mean, standard deviation and confidence interval */
+    bench.to_stats_table(std::cout, label_out);
+
+    /** Aggregated flamegraph, mean per iteration */
+    std::ofstream myfile(fileName);
+    bench.to_collapsed_stacks(myfile, label_out);
+    myfile.close();
+    std::cout << "Output written to " << fileName << "\n";
+}
@@ -0,0 +1,61 @@
+#include <iostream>
+#include <fstream>
+#include "../fiya-budget.h"
+
+using namespace fiya;
+
+using my_measure_time_t = measure_time_t<const char*, sampled_time_value_t>;
+using my_budget_measure_time_t = budget_measure_time_t<const char*>;
+
+/** We need a recorder, once per thread. */
+thread_local my_measure_time_t::recorder_type my_recorder({}, "root", sampled_time_value_t::now());
+
+/** The controller keeps the overhead under 2% of the thread's CPU time */
+thread_local budget_controller_t my_controller(calibrate_overhead(), budget_options_t{ 0.02, std::chrono::milliseconds(20) });
+
+/** Convenient function wrappers */
+#define MEASURE_FUNC my_measure_time_t m(__FUNCTION__, &my_recorder)
+#define MEASURE_FUNC_BUDGET(level) \
+    static thread_local budget_scope_t fiya_scope(__FUNCTION__, 1, level); \
+    my_budget_measure_time_t m(__FUNCTION__, &my_recorder, fiya_scope, &my_controller)
+
+/** We use this to busy wait in a function */
+void busy_wait(int64_t v) {
+    int64_t num = v * 10;
+    while (num--) (void) rand();
+}
+
+/** Called very often, too often to be measured on each call */
+void compare_keys() {
+    MEASURE_FUNC_BUDGET(level_t::fine);
+    busy_wait(1);
+}
+
+void hash_key() {
+    MEASURE_FUNC_BUDGET(level_t::normal);
+    busy_wait(2);
+}
+
+void process_request() {
+    MEASURE_FUNC_BUDGET(level_t::coarse);
+    for (int i = 0; i < 1000; i++) {
+        hash_key();
+        compare_keys();
+    }
+}
+
+int main(int argc, char **argv) {
+    for (int i = 0; i < 2000; i++) {
+        process_request();
+        my_controller.check();
+    }
+
+    my_controller.to_throttle_report(std::cout);
+
+    auto label_out = [] (std::ostream& os, const char* const & l) {
+        os << l;
+    };
+    std::ofstream myfile("fiya-budget.txt");
+    my_recorder.to_collapsed_stacks(myfile, label_out, sampled_time_out);
+    std::cout << "Output written to fiya-budget.txt\n";
+}
@@ -0,0 +1,66 @@
+#include <iostream>
+#include <fstream>
+#include "../fiya-counters.h"
+
+using namespace fiya;
+
+/** Up to 4 user defined counters, recorded together with time */
+using my_measure_t = measure_counted_time_t<const char*, 4>;
+
+/** We need a recorder, once per thread. */
+thread_local my_measure_t::recorder_type my_recorder({}, "root", counted_time_value_t<4>::now());
+
+/** Counter names are registered once, at startup. */
+counter_registry_t<4> my_counters;
+const counter_id_t rows_processed = my_counters.register_counter("rows processed");
+const counter_id_t bytes_parsed = my_counters.register_counter("bytes parsed");
+
+/** Convenient function wrapper  */
+#define MEASURE_FUNC my_measure_t m(__FUNCTION__, &my_recorder)
+
+/** We use this to busy wait in a function */
+void busy_wait(int64_t v) {
+    int64_t num = v * 100000;
+    while (num--) (void) rand();
+}
+
+/** A few test functions */
+void parse_row(int64_t bytes) {
+    MEASURE_FUNC;
+    busy_wait(bytes / 100);
+    add_counter(&my_recorder, bytes_parsed, bytes);
+}
+
+void process_rows(int rows) {
+    MEASURE_FUNC;
+    for (int i = 0; i < rows; i++) {
+        parse_row(100 + i % 3 * 100);
+        busy_wait(1);
+    }
+    add_counter(&my_recorder, rows_processed, rows);
+}
+
+void load() {
+    MEASURE_FUNC;
+    process_rows(10);
+    process_rows(20);
+}
+
+const char * fileName = "fiya-counters-bytes.txt";
+
+int main(int argc, char **argv) {
+    load();
+
+    auto label_out = [] (std::ostream& os, const char* const & l) {
+        os << l;
+    };
+
+    /** Flamegraph of one counter */
+    std::ofstream myfile(fileName);
+    my_recorder.to_collapsed_stacks(myfile, label_out, counter_out<4>(bytes_parsed));
+    myfile.close();
+
+    /** Per path throughput */
+    to_throughput_table<const char*, 4>(my_recorder, my_counters, std::cout, label_out);
+    std::cout << "Output written to " << fileName << "\n";
+}
@@ -0,0 +1,52 @@
+#include <iostream>
+#include "../fiya-decay.h"
+
+using namespace fiya;
+
+/** Time recorded one second ago counts half */
+decay_t my_decay(std::chrono::seconds(1));
+
+using my_measure_t = measure_decayed_time_t<const char*>;
+
+/** We need a recorder, once per thread. */
+thread_local my_measure_t::recorder_type my_recorder({}, "root", decayed_time_value_t::now());
+
+/** Convenient function wrapper  */
+#define MEASURE_FUNC my_measure_t m(__FUNCTION__, &my_recorder, &my_decay)
+
+/** We use this to busy wait in a function */
+void busy_wait(int64_t v) {
+    int64_t num = v * 100000;
+    while (num--) (void) rand();
+}
+
+/** A few test functions */
+void startup() {
+    MEASURE_FUNC;
+    busy_wait(1);
+}
+
+void serve() {
+    MEASURE_FUNC;
+    busy_wait(1);
+}
+
+int main(int argc, char **argv) {
+    auto label_out = [] (std::ostream& os, const char* const & l) {
+        os << l;
+    };
+
+    /* The live tree follows the change from startup to serving */
+    for (int second = 0; second < 6; second++) {
+        auto start = std::chrono::steady_clock::now();
+        while (std::chrono::steady_clock::now() - start < std::chrono::milliseconds(500)) {
+            if (second < 2) {
+                startup();
+            } else {
+                serve();
+            }
+        }
+        std::cout << "After " << (second + 1) * 500 << " ms:\n";
+        my_recorder.to_collapsed_stacks(std::cout, label_out, decayed_time_out(my_decay));
+    }
+}
@@ -0,0 +1,39 @@
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include "../fiya-gauges.h"
+
+using namespace fiya;
+
+/** A gauge, read by the sampler thread */
+std::atomic<int> queue_depth { 0 };
+
+/** We use this to busy wait in a function */
+void busy_wait(int64_t v) {
+    int64_t num = v * 100000;
+    while (num--) (void) rand();
+}
+
+int main(int argc, char **argv) {
+    gauge_sampler_t sampler(std::chrono::milliseconds(10));
+    sampler.add_gauge("queue depth", [] { return static_cast<double>(queue_depth.load()); });
+    sampler.add_current_thread("main");
+    sampler.start();
+
+    /* The queue fills while the thread is idle and drains while it works */
+    for (int round = 0; round < 5; round++) {
+        for (int i = 0; i < 20; i++) {
+            queue_depth++;
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        while (queue_depth > 0) {
+            busy_wait(1);
+            queue_depth--;
+        }
+    }
+
+    sampler.stop();
+    std::ofstream trace("fiya-gauges.json");
+    sampler.to_chrome_trace(trace);
+    std::cout << "Open fiya-gauges.json in Perfetto or chrome://tracing\n";
+}
@@ -0,0 +1,61 @@
+#include <thread>
+#include <fstream>
+#include <iostream>
+#include "../fiya-heatmap.h"
+
+using namespace fiya;
+
+/** 10 columns of one second, rows of 20 ms */
+using my_recorder_t = heatmap_recorder_t<const char*, 10, 50>;
+
+/** We need a recorder, once per thread. */
+thread_local my_recorder_t my_recorder("root");
+
+/** Convenient function wrapper  */
+#define MEASURE_FUNC measure_heatmap_t<my_recorder_t> m(__FUNCTION__, &my_recorder)
+
+/** We use this to busy wait in a function */
+void busy_wait(int64_t v) {
+    int64_t num = v * 10000;
+    while (num--) (void) rand();
+}
+
+/** A few test functions */
+void handle() {
+    MEASURE_FUNC;
+    busy_wait(1);
+}
+
+/** Runs every 250 ms, invisible in a cumulative flamegraph */
+void flush() {
+    MEASURE_FUNC;
+    busy_wait(50);
+}
+
+int main(int argc, char **argv) {
+    my_recorder.select_label("flush");
+
+    auto start = std::chrono::steady_clock::now();
+    auto next_flush = start;
+    while (std::chrono::steady_clock::now() - start < std::chrono::seconds(3)) {
+        if (std::chrono::steady_clock::now() >= next_flush) {
+            flush();
+            next_flush += std::chrono::milliseconds(250);
+        }
+        handle();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    std::ofstream thread_svg("fiya-heatmap-thread.svg");
+    my_recorder.thread_heatmap().to_svg(thread_svg, "Thread");
+    std::ofstream flush_svg("fiya-heatmap-flush.svg");
+    my_recorder.label_heatmap().to_svg(flush_svg, "flush");
+
+    auto label_out = [] (std::ostream& os, const char* const & l) {
+        os << l;
+    };
+    std::cout << "Cumulative:\n";
+    my_recorder.to_collapsed_stacks(std::cout, label_out);
+    std::cout << "From 1000 ms to 1020 ms:\n";
+    my_recorder.to_range_collapsed_stacks(std::cout, label_out, 1000000000, 1020000000);
+}
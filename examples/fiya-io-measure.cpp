@@ -0,0 +1,96 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include "../fiya-io-measure.h"
+
+using namespace fiya;
+
+/** We specialize measure_io_t using const char* labels */
+using my_measure_io_t = measure_io_t<const char*>;
+
+/** Instance of my recorder. Each thread gets it's own recorder. */
+thread_local my_measure_io_t::recorder_type my_recorder(io_usage_t{}, "root", io_usage_t{});
+
+/** We need to export this function for fiya-io-overloads.cpp */
+fiya::counter_interface_t<fiya::io_usage_t> * get_io_counter() {
+    return &my_recorder;
+}
+
+/** Convenient function wrapper  */
+#define MEASURE_FUNC my_measure_io_t m(__FUNCTION__, &my_recorder)
+
+const char * dataFileName = "fiya-io-measure.dat";
+
+/** Writes @n blocks of 4 kB to the file and syncs it. */
+void write_blocks(int fd, int n) {
+    std::vector<char> block(4096, 'x');
+    for (int i = 0; i < n; i++) {
+        (void) write(fd, block.data(), block.size());
+    }
+    fsync(fd);
+}
+
+/** Reads @n blocks of 4 kB from the beginning of the file. */
+void read_blocks(int fd, int n) {
+    std::vector<char> block(4096);
+    for (int i = 0; i < n; i++) {
+        (void) pread(fd, block.data(), block.size(), i * block.size());
+    }
+}
+
+/** Test functions */
+void func3(int fd) {
+    MEASURE_FUNC;
+    read_blocks(fd, 100);
+}
+
+void func2(int fd) {
+    MEASURE_FUNC;
+    write_blocks(fd, 10);
+    func3(fd);
+}
+
+void func1(int fd) {
+    MEASURE_FUNC;
+    write_blocks(fd, 100);
+    func2(fd);
+    read_blocks(fd, 10);
+}
+
+const char * bytesFileName = "fiya-io-bytes.txt";
+const char * waitFileName = "fiya-io-wait.txt";
+
+int main(int argc, char **argv) {
+    int fd = open(dataFileName, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        std::cerr << "Cannot open " << dataFileName << "\n";
+        return 1;
+    }
+    func1(fd);
+    close(fd);
+    unlink(dataFileName);
+
+    /** The same tree gives us two flamegraphs: I/O bytes and I/O wait. */
+    std::ofstream bytes_file(bytesFileName);
+    my_recorder.to_collapsed_stacks(
+        bytes_file,
+        [] (std::ostream& os, const char* const & l) {
+            os << l;
+        },
+        io_bytes_out);
+    bytes_file.close();
+
+    std::ofstream wait_file(waitFileName);
+    my_recorder.to_collapsed_stacks(
+        wait_file,
+        [] (std::ostream& os, const char* const & l) {
+            os << l;
+        },
+        io_wait_out);
+    wait_file.close();
+
+    std::cout << "Output written to " << bytesFileName << " and " << waitFileName << "\n";
+    std::cout << "Open site speedscope.app and drag the files there.\n";
+}
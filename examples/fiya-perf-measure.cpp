@@ -0,0 +1,86 @@
+#include <iostream>
+#include <fstream>
+#include <thread>
+#include <vector>
+#include <sys/mman.h>
+#include "../fiya-perf-measure.h"
+
+using namespace fiya;
+
+/** We specialize measure_perf_t using const char* labels */
+using my_measure_perf_t = measure_perf_t<const char*>;
+
+/** We need a recorder and a counter reader, once per thread. */
+thread_local my_measure_perf_t::recorder_type my_recorder(perf_value_t{}, "root", perf_value_t{});
+thread_local perf_counters_t my_counters(true);
+
+/** Convenient function wrapper  */
+#define MEASURE_FUNC my_measure_perf_t m(__FUNCTION__, &my_recorder, &my_counters)
+
+/** Touches @pages fresh pages, causing minor page faults. */
+void touch_pages(size_t pages) {
+    size_t size = pages * 4096;
+    char * p = reinterpret_cast<char*>(mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    if (p == MAP_FAILED) {
+        return;
+    }
+    for (size_t i = 0; i < size; i += 4096) {
+        p[i] = 1;
+    }
+    munmap(p, size);
+}
+
+/** Sleeps a few times, causing voluntary context switches. */
+void yield_cpu(int times) {
+    for (int i = 0; i < times; i++) {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+}
+
+/** Test functions */
+void func3() {
+    MEASURE_FUNC;
+    touch_pages(1000);
+}
+
+void func2() {
+    MEASURE_FUNC;
+    yield_cpu(50);
+    func3();
+}
+
+void func1() {
+    MEASURE_FUNC;
+    touch_pages(100);
+    func2();
+    yield_cpu(10);
+}
+
+const char * fileName = "fiya-perf-measure.txt";
+
+int main(int argc, char **argv) {
+    func1();
+
+    std::cout << "Using " << (my_counters.uses_perf_events() ? "perf events" : "getrusage") <<
+        ", hardware events " << (my_counters.hardware_enabled() ? "enabled" : "disabled") << "\n";
+
+    std::ofstream myfile(fileName);
+    /** Page fault flamegraph. Use perf_context_switches_out for context switches. */
+    my_recorder.to_collapsed_stacks(
+        myfile,
+        [] (std::ostream& os, const char* const & l) {
+            os << l;
+        },
+        perf_page_faults_out);
+    myfile.close();
+
+    auto my_report = my_recorder.to_report();
+    for (const auto& v: my_report.report) {
+        std::cout << v.first <<
+            ": context switches " << v.second.total.context_switches <<
+            ", page faults " << v.second.total.minor_faults + v.second.total.major_faults <<
+            ", migrations " << v.second.total.cpu_migrations <<
+            ", instructions " << v.second.total.instructions << "\n";
+    }
+    std::cout << "Output written to " << fileName << "\n";
+}
@@ -0,0 +1,64 @@
+#include <iostream>
+#include <fstream>
+#include "../fiya-sampling.h"
+
+using namespace fiya;
+
+/** Sampled and regular scopes share the recorder */
+using my_measure_time_t = measure_time_t<const char*, sampled_time_value_t>;
+using my_sampled_measure_time_t = sampled_measure_time_t<const char*>;
+
+/** We need a recorder, once per thread. */
+thread_local my_measure_time_t::recorder_type my_recorder({}, "root", sampled_time_value_t::now());
+
+/** Convenient function wrappers. The sampled one records one invocation in @period. */
+#define MEASURE_FUNC my_measure_time_t m(__FUNCTION__, &my_recorder)
+#define MEASURE_FUNC_SAMPLED(period) \
+    static thread_local sampler_t fiya_sampler(period, true); \
+    my_sampled_measure_time_t m(__FUNCTION__, &my_recorder, fiya_sampler)
+
+/** We use this to busy wait in a function */
+void busy_wait(int64_t v) {
+    int64_t num = v * 100;
+    while (num--) (void) rand();
+}
+
+/** Called millions of times, too often to measure each invocation */
+void hash_key(int64_t v) {
+    MEASURE_FUNC_SAMPLED(1000);
+    busy_wait(v);
+}
+
+void insert_rows(int rows) {
+    MEASURE_FUNC;
+    for (int i = 0; i < rows; i++) {
+        hash_key(1 + i % 4);
+        busy_wait(1);
+    }
+}
+
+void lookup_rows(int rows) {
+    MEASURE_FUNC;
+    for (int i = 0; i < rows; i++) {
+        hash_key(2);
+    }
+}
+
+const char * fileName = "fiya-sampling.txt";
+
+int main(int argc, char **argv) {
+    insert_rows(2000000);
+    lookup_rows(1000000);
+
+    auto label_out = [] (std::ostream& os, const char* const & l) {
+        os << l;
+    };
+
+    std::ofstream myfile(fileName);
+    my_recorder.to_collapsed_stacks(myfile, label_out, sampled_time_out);
+    myfile.close();
+
+    std::cout << "Call counts:\n";
+    my_recorder.to_collapsed_stacks(std::cout, label_out, sampled_calls_out);
+    std::cout << "Output written to " << fileName << "\n";
+}
@@ -0,0 +1,67 @@
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include "../fiya-stack-measure.h"
+
+using namespace fiya;
+
+/** We specialize measure_stack_t using const char* labels */
+using my_measure_stack_t = measure_stack_t<const char*>;
+
+/** Instance of my recorder. Each thread gets it's own recorder. */
+thread_local my_measure_stack_t::recorder_type my_recorder(stack_usage_t{}, "root", stack_usage_t{});
+
+/** Convenient function wrapper  */
+#define MEASURE_FUNC my_measure_stack_t m(__FUNCTION__, &my_recorder)
+
+/** Uses @n bytes of stack, so the compiler can't remove the buffer. */
+#define USE_STACK(n) \
+    volatile char buffer[n]; \
+    memset(const_cast<char*>(buffer), 0, sizeof(buffer))
+
+/** Test functions */
+void func4() {
+    MEASURE_FUNC;
+    USE_STACK(128);
+}
+
+void func3() {
+    MEASURE_FUNC;
+    USE_STACK(4096);
+    func4();
+}
+
+void func2(int n) {
+    MEASURE_FUNC;
+    USE_STACK(256);
+    if (n > 0) {
+        func2(n - 1);
+    } else {
+        func3();
+    }
+}
+
+void func1() {
+    MEASURE_FUNC;
+    USE_STACK(1024);
+    func2(3);
+    func4();
+}
+
+const char * fileName = "fiya-stack-measure.txt";
+
+int main(int argc, char **argv) {
+    func1();
+
+    auto label_out = [] (std::ostream& os, const char* const & l) {
+        os << l;
+    };
+
+    std::ofstream myfile(fileName);
+    to_stack_collapsed_stacks<const char*>(my_recorder, myfile, label_out);
+    myfile.close();
+
+    std::cout << "Worst case stack path: ";
+    to_worst_stack_path<const char*>(my_recorder, std::cout, label_out);
+    std::cout << "Output written to " << fileName << "\n";
+}
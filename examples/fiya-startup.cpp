@@ -0,0 +1,64 @@
+#include <iostream>
+#include <cstdlib>
+
+#include "../fiya-startup.h"
+
+using namespace fiya;
+
+/** We use this to busy wait in a function */
+void busy_wait(int64_t v) {
+    int64_t num = v * 1000000;
+    while (num--) (void) rand();
+}
+
+/** Static objects, constructed before main */
+struct config_t {
+    config_t() {
+        parse_config();
+    }
+
+    void parse_config() {
+        busy_wait(20);
+    }
+};
+
+struct plugin_registry_t {
+    plugin_registry_t() {
+        for (int i = 0; i < 3; i++) {
+            register_plugin(i);
+        }
+    }
+
+    void register_plugin(int id) {
+        busy_wait(5 + id);
+    }
+};
+
+config_t config;
+plugin_registry_t plugins;
+
+/** Initialization done in main */
+void open_database() {
+    busy_wait(30);
+}
+
+void warm_cache() {
+    busy_wait(10);
+}
+
+void serve() {
+    busy_wait(5);
+}
+
+int main(int argc, char **argv) {
+    startup_main();
+
+    open_database();
+    warm_cache();
+
+    /* Writes the profile of the startup to fiya-startup.txt */
+    startup_ready();
+    std::cout << "Startup profile written to fiya-startup.txt\n";
+
+    serve();
+}
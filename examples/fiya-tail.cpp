@@ -0,0 +1,77 @@
+#include <iostream>
+#include <fstream>
+#include "../fiya-tail.h"
+
+using namespace fiya;
+
+using my_measure_time_t = measure_time_t<const char*>;
+using my_tail_request_t = tail_request_t<const char*>;
+
+/** Requests slower than 2 ms are slow, the 3 slowest are kept */
+tail_capture_t<const char*> my_capture("root", tail_options_t{ std::chrono::milliseconds(2), 3, true });
+
+/** Recorder of the request the thread is handling */
+thread_local my_measure_time_t::recorder_type * my_recorder = nullptr;
+
+/** Convenient function wrapper  */
+#define MEASURE_FUNC my_measure_time_t m(__FUNCTION__, my_recorder)
+
+/** We use this to busy wait in a function */
+void busy_wait(int64_t v) {
+    int64_t num = v * 10000;
+    while (num--) (void) rand();
+}
+
+/** A few test functions */
+void parse() {
+    MEASURE_FUNC;
+    busy_wait(5);
+}
+
+void cache_miss() {
+    MEASURE_FUNC;
+    busy_wait(40);
+}
+
+void lookup(int i) {
+    MEASURE_FUNC;
+    /* One request in 20 misses the cache */
+    if (i % 20 == 7) {
+        cache_miss();
+    }
+    busy_wait(2);
+}
+
+void handle_request(int i) {
+    my_tail_request_t request("handle_request", &my_capture);
+    my_recorder = request.recorder();
+
+    parse();
+    lookup(i);
+}
+
+int main(int argc, char **argv) {
+    for (int i = 0; i < 200; i++) {
+        handle_request(i);
+    }
+
+    auto label_out = [] (std::ostream& os, const char* const & l) {
+        os << l;
+    };
+    auto time_out = [] (std::ostream& os, const time_value_t& m) {
+        os << std::chrono::duration_cast<std::chrono::microseconds>(m.get_duration()).count();
+    };
+
+    std::cout << my_capture.slow_requests() << " of " << my_capture.requests() << " requests were slow\n";
+
+    std::ofstream slow("fiya-tail-slow.txt");
+    my_capture.slow_aggregate().to_collapsed_stacks(slow, label_out, time_out);
+    std::ofstream fast("fiya-tail-fast.txt");
+    my_capture.fast_aggregate().to_collapsed_stacks(fast, label_out, time_out);
+
+    my_capture.for_each_slowest([&] (std::chrono::steady_clock::duration latency, my_measure_time_t::recorder_type& recorder) {
+        std::cout << "Request taking " << std::chrono::duration_cast<std::chrono::microseconds>(latency).count() << " us:\n";
+        recorder.to_collapsed_stacks(std::cout, label_out, time_out);
+    });
+    std::cout << "Output written to fiya-tail-slow.txt and fiya-tail-fast.txt\n";
+}
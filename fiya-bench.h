@@ -0,0 +1,208 @@
+#pragma once
+
+#include <cmath>
+#include <vector>
+#include <ostream>
+#include <algorithm>
+#include <functional>
+
+#include "fiya-time-measure.h"
+
+namespace fiya {
+
+/** Options of bench_t */
+struct bench_options_t {
+    /** Number of measured iterations */
+    size_t iterations = 100;
+    /** Number of iterations run before the measured ones, not recorded */
+    size_t warmup = 10;
+};
+
+/** @brief Accumulated samples of one path, in nanoseconds. Iterations
+ *         where the path didn't appear count as zero.
+ */
+struct bench_samples_t {
+    double sum = 0.0;
+    double sum_squares = 0.0;
+};
+
+/** Statistics of one path over all measured iterations, in nanoseconds */
+struct bench_stats_t {
+    double mean;
+    double stddev;
+    /** Lower and upper bound of the 95% confidence interval of the mean */
+    double ci_low;
+    double ci_high;
+};
+
+/** @brief Benchmark harness recording FIYA scopes from each iteration.
+ *
+ *  The callable is run with a pointer to a fresh recorder for each
+ *  iteration, so measure_time_t scopes inside it build a per-iteration
+ *  tree. The trees of the measured iterations are merged into per path
+ *  statistics: mean, standard deviation and confidence interval of the
+ *  self time, and an aggregated flamegraph of the mean.
+ *
+ *  @code
+ *  bench_t<const char*> b("root");
+ *  b.run([] (bench_t<const char*>::recorder_type* recorder) {
+ *      measure_time_t<const char*> m("my_function", recorder);
+ *      my_function();
+ *  });
+ *  b.to_stats_table(std::cout, [] (std::ostream& os, const char* const & l) { os << l; });
+ *  @endcode
+ */
+template <typename LabelType>
+class bench_t {
+public:
+    /** Recorder passed to the callable in each iteration */
+    using recorder_type = typename measure_time_t<LabelType>::recorder_type;
+
+    /** Constructor
+     *
+     *    @param root_label Label of the root of each iteration's tree
+     *    @param options    Number of iterations and warmup iterations
+     */
+    bench_t(const LabelType& root_label, const bench_options_t& options = bench_options_t()) :
+        m_root_label(root_label),
+        m_options(options),
+        m_samples(bench_samples_t{}, root_label, bench_samples_t{})
+    { }
+
+    /** @brief Runs the callable @options.warmup + @options.iterations times.
+     *         Calling it again adds more iterations to the statistics.
+     *
+     *  @param callable Function with signature void(recorder_type* recorder)
+     */
+    template <typename Callable>
+    void run(const Callable& callable) {
+        for (size_t i { 0U }; i < m_options.warmup; i++) {
+            recorder_type recorder({}, m_root_label, time_value_t::now());
+            callable(&recorder);
+        }
+
+        for (size_t i { 0U }; i < m_options.iterations; i++) {
+            recorder_type recorder({}, m_root_label, time_value_t::now());
+            callable(&recorder);
+            /* The time since the last scope transition belongs to the root */
+            recorder.cnt().m_duration += get_thread_time<void>() - recorder.cnt().m_start;
+
+            double iteration_ns = 0.0;
+            m_samples.merge(recorder, [&iteration_ns] (bench_samples_t& dst, const time_value_t& src) {
+                double ns = std::chrono::duration<double, std::nano>(src.get_duration()).count();
+                dst.sum += ns;
+                dst.sum_squares += ns * ns;
+                iteration_ns += ns;
+            });
+            m_iteration_ns.push_back(iteration_ns);
+        }
+    }
+
+    /** Returns the number of measured iterations */
+    size_t iterations() const {
+        return m_iteration_ns.size();
+    }
+
+    /** Returns the statistics of the whole iteration time */
+    bench_stats_t iteration_stats() const {
+        bench_samples_t samples;
+        for (double ns: m_iteration_ns) {
+            samples.sum += ns;
+            samples.sum_squares += ns * ns;
+        }
+        return calculate_stats(samples);
+    }
+
+    /** @brief Calls @visitor with the statistics of the self time of every path.
+     *
+     *  @param visitor Function receiving the labels on the path from the root
+     *                 to the node and the statistics of the node
+     */
+    void for_each_path(const std::function<void(const std::vector<LabelType>& path, const bench_stats_t& stats)>& visitor) {
+        m_samples.for_each_path([&] (const std::vector<LabelType>& path, const bench_samples_t& samples) {
+            visitor(path, calculate_stats(samples));
+        });
+    }
+
+    /** @brief Writes a tab separated table with the path and the mean, standard
+     *         deviation and 95% confidence interval of its self time, in microseconds.
+     */
+    void to_stats_table(std::ostream& os, const std::function<void(std::ostream& os, const LabelType& l)> & l_out) {
+        bench_stats_t total = iteration_stats();
+        os << "iterations\t" << iterations() << "\n";
+        os << "iteration\t" << total.mean / 1000.0 << "\t" << total.stddev / 1000.0 << "\t" <<
+            total.ci_low / 1000.0 << "\t" << total.ci_high / 1000.0 << "\n";
+        os << "path\tmean_us\tstddev_us\tci95_low_us\tci95_high_us\n";
+
+        for_each_path([&] (const std::vector<LabelType>& path, const bench_stats_t& stats) {
+            for (size_t i { 0U }; i < path.size(); i++) {
+                if (i > 0) {
+                    os << ";";
+                }
+                l_out(os, path[i]);
+            }
+            os << "\t" << stats.mean / 1000.0 << "\t" << stats.stddev / 1000.0 << "\t" <<
+                stats.ci_low / 1000.0 << "\t" << stats.ci_high / 1000.0 << "\n";
+        });
+    }
+
+    /** @brief Writes the aggregated flamegraph in the collapsed stack format,
+     *         with the mean self time per iteration in microseconds.
+     */
+    void to_collapsed_stacks(std::ostream& os, const std::function<void(std::ostream& os, const LabelType& l)> & l_out) {
+        size_t n = std::max<size_t>(iterations(), 1U);
+        m_samples.to_collapsed_stacks(os, l_out, [n] (std::ostream& os, const bench_samples_t& samples) {
+            os << static_cast<uint64_t>(samples.sum / n / 1000.0 + 0.5);
+        });
+    }
+
+private:
+    /** Label of the root of the per-iteration trees */
+    LabelType m_root_label;
+    /** Number of iterations */
+    bench_options_t m_options;
+    /** Per path sums over the measured iterations */
+    recorder_t<LabelType, bench_samples_t> m_samples;
+    /** Time of each measured iteration */
+    std::vector<double> m_iteration_ns;
+
+    /** @brief Returns the critical value of Student's t distribution for
+     *         a two sided 95% confidence interval with @df degrees of freedom.
+     */
+    static double t_critical_95(size_t df) {
+        static const double table[] = {
+            12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+            2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+            2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+        };
+        if (df == 0) {
+            return 0.0;
+        }
+        if (df <= 30) {
+            return table[df - 1];
+        }
+        return df <= 60 ? 2.000 : (df <= 120 ? 1.980 : 1.960);
+    }
+
+    /** Calculates the statistics of the samples over all measured iterations */
+    bench_stats_t calculate_stats(const bench_samples_t& samples) const {
+        size_t n = iterations();
+        bench_stats_t result {};
+        if (n == 0) {
+            return result;
+        }
+
+        result.mean = samples.sum / n;
+        if (n > 1) {
+            double variance = (samples.sum_squares - n * result.mean * result.mean) / (n - 1);
+            result.stddev = std::sqrt(std::max(variance, 0.0));
+        }
+
+        double half_width = t_critical_95(n - 1) * result.stddev / std::sqrt(static_cast<double>(n));
+        result.ci_low = result.mean - half_width;
+        result.ci_high = result.mean + half_width;
+        return result;
+    }
+};
+
+}
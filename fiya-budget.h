@@ -0,0 +1,294 @@
+#pragma once
+
+#include <cmath>
+#include <chrono>
+#include <limits>
+#include <vector>
+#include <cstdint>
+#include <ostream>
+#include <algorithm>
+
+#include "fiya-sampling.h"
+
+namespace fiya {
+
+/** Cost of the instrumentation, measured by calibrate_overhead() */
+struct overhead_cost_t {
+    /** CPU time of one recorded scope: opening and closing it */
+    std::chrono::nanoseconds::rep recorded_ns;
+    /** CPU time of one invocation that was not sampled */
+    double unsampled_ns;
+};
+
+/** @brief Measures the CPU time of recorded and of unsampled scopes on a
+ *         scratch recorder. Takes a few milliseconds.
+ */
+inline overhead_cost_t calibrate_overhead(size_t iterations = 100000) {
+    using clock_duration = std::chrono::duration<double, std::nano>;
+    recorder_t<int, sampled_time_value_t> recorder({}, 0, sampled_time_value_t::now());
+    overhead_cost_t result;
+
+    sampler_t every(1);
+    auto start = get_thread_time<void>();
+    for (size_t i { 0U }; i < iterations; i++) {
+        sampled_measure_time_t<int> m(1, &recorder, every);
+    }
+    auto end = get_thread_time<void>();
+    result.recorded_ns = static_cast<std::chrono::nanoseconds::rep>(clock_duration(end - start).count() / iterations + 0.5);
+
+    sampler_t never(std::numeric_limits<uint32_t>::max());
+    never.next();
+    start = get_thread_time<void>();
+    for (size_t i { 0U }; i < iterations * 10; i++) {
+        sampled_measure_time_t<int> m(1, &recorder, never);
+    }
+    end = get_thread_time<void>();
+    result.unsampled_ns = clock_duration(end - start).count() / (iterations * 10);
+
+    return result;
+}
+
+/** @brief A sampled scope whose period is controlled by budget_controller_t.
+ *         Declare it as a static thread_local next to the scope, like
+ *         sampler_t, and measure with budget_measure_time_t.
+ */
+class budget_scope_t: public sampler_t {
+public:
+    /** Constructor
+     *
+     *    @param name   Name of the scope in the throttle report
+     *    @param period Initial average number of invocations per sample, 1 records every invocation
+     *    @param level  Fine scopes are disabled before the others are sampled less often
+     *    @param random Use random distances between samples
+     */
+    constexpr budget_scope_t(const char * name, uint32_t period = 1, level_t level = level_t::normal, bool random = false) :
+        sampler_t(period, random),
+        m_name(name),
+        m_level(level),
+        m_initial_period(period > 0 ? period : 1),
+        m_registered(false),
+        m_disabled(false),
+        m_last_calls(0),
+        m_last_samples(0),
+        m_overhead_ns(0.0)
+    { }
+
+    /** Returns the name of the scope */
+    const char * name() const {
+        return m_name;
+    }
+
+    /** Returns the level of the scope */
+    level_t level() const {
+        return m_level;
+    }
+
+    /** Returns true if the controller disabled the scope */
+    bool disabled() const {
+        return m_disabled;
+    }
+
+    /** Returns true once the scope is known to a controller */
+    bool registered() const {
+        return m_registered;
+    }
+private:
+    const char * m_name;
+    level_t m_level;
+    uint32_t m_initial_period;
+    /** True once the scope is known to the controller */
+    bool m_registered;
+    /** True if the controller disabled the scope */
+    bool m_disabled;
+    /** calls() and samples() at the last check of the controller */
+    uint64_t m_last_calls;
+    uint64_t m_last_samples;
+    /** Estimated overhead in the last window of the controller */
+    double m_overhead_ns;
+
+    friend class budget_controller_t;
+};
+
+/** Options of budget_controller_t */
+struct budget_options_t {
+    /** Allowed instrumentation overhead, as a fraction of the thread's CPU time */
+    double budget = 0.02;
+    /** CPU time of the thread between two adjustments */
+    std::chrono::milliseconds window = std::chrono::milliseconds(100);
+    /** Largest period before a scope is disabled */
+    uint32_t max_period = 1U << 20;
+    /** If the overhead drops under budget * relax_ratio, throttled scopes
+     *  get back towards their initial period
+     */
+    double relax_ratio = 0.25;
+};
+
+/** @brief Keeps the overhead of budget scopes under a fraction of the
+ *         thread's CPU time.
+ *
+ *  The overhead of each scope is estimated as its samples times the
+ *  calibrated cost of a recorded scope plus its calls times the cost of an
+ *  unsampled one. When the overhead of a window exceeds the budget, the most
+ *  expensive scopes are throttled first: fine scopes are disabled, the others
+ *  sample less often, until the estimate fits. Scopes measured with
+ *  measure_time_t are not controlled.
+ *
+ *  When the overhead is well under the budget, the throttled scopes get
+ *  back towards their initial period, and the disabled scopes are enabled
+ *  again at max_period. A disabled scope doesn't count its calls, so this
+ *  is how the controller finds out whether it still is too expensive; if
+ *  so, the next window disables it again.
+ *
+ *  Use one controller per thread, together with the thread's recorder, and
+ *  call check() regularly, e.g. after each request; it does nothing until a
+ *  window of CPU time has passed.
+ */
+class budget_controller_t {
+public:
+    budget_controller_t(const overhead_cost_t& cost, const budget_options_t& options = budget_options_t()) :
+        m_cost(cost),
+        m_options(options),
+        m_window_start(get_thread_time<void>())
+    { }
+
+    /** Adds @scope to the controlled scopes. Called by budget_measure_time_t. */
+    void add(budget_scope_t * scope) {
+        if (!scope->m_registered) {
+            scope->m_registered = true;
+            scope->m_last_calls = scope->calls();
+            scope->m_last_samples = scope->samples();
+            m_scopes.push_back(scope);
+        }
+    }
+
+    /** @brief Estimates the overhead of the window that just ended and
+     *         throttles or relaxes the scopes. Does nothing if the window
+     *         is not over yet.
+     */
+    void check() {
+        auto now = get_thread_time<void>();
+        if (now - m_window_start < m_options.window) {
+            return;
+        }
+        double cpu_ns = std::chrono::duration<double, std::nano>(now - m_window_start).count();
+        m_window_start = now;
+
+        double overhead_ns = 0.0;
+        for (budget_scope_t * scope: m_scopes) {
+            scope->m_overhead_ns = (scope->samples() - scope->m_last_samples) * static_cast<double>(m_cost.recorded_ns) +
+                (scope->calls() - scope->m_last_calls) * m_cost.unsampled_ns;
+            scope->m_last_calls = scope->calls();
+            scope->m_last_samples = scope->samples();
+            overhead_ns += scope->m_overhead_ns;
+        }
+        m_last_ratio = overhead_ns / cpu_ns;
+
+        double allowed_ns = cpu_ns * m_options.budget;
+        if (overhead_ns > allowed_ns) {
+            throttle(overhead_ns, allowed_ns);
+        } else if (overhead_ns < allowed_ns * m_options.relax_ratio) {
+            relax();
+        }
+    }
+
+    /** Returns the estimated overhead of the last window, as a fraction of CPU time */
+    double overhead_ratio() const {
+        return m_last_ratio;
+    }
+
+    /** @brief Writes a tab separated report of the controlled scopes: the
+     *         initial and the current period, whether the scope is disabled,
+     *         the calls and samples and the overhead in the last window.
+     */
+    void to_throttle_report(std::ostream& os) const {
+        os << "overhead\t" << m_last_ratio << "\tbudget\t" << m_options.budget << "\n";
+        os << "scope\tlevel\tinitial_period\tperiod\tdisabled\tcalls\tsamples\toverhead_ns\n";
+        for (const budget_scope_t * scope: m_scopes) {
+            static const char * levels[] = { "coarse", "normal", "fine" };
+            os << scope->name() << "\t" << levels[static_cast<int>(scope->m_level)] << "\t" <<
+                scope->m_initial_period << "\t" << scope->period() << "\t" <<
+                (scope->m_disabled ? "yes" : "no") << "\t" << scope->calls() << "\t" <<
+                scope->samples() << "\t" << scope->m_overhead_ns << "\n";
+        }
+    }
+private:
+    /** Calibrated cost of the instrumentation */
+    overhead_cost_t m_cost;
+    /** Budget and window */
+    budget_options_t m_options;
+    /** Thread CPU time when the current window started */
+    std::chrono::time_point<std::chrono::high_resolution_clock> m_window_start;
+    /** Controlled scopes */
+    std::vector<budget_scope_t*> m_scopes;
+    /** Estimated overhead of the last window */
+    double m_last_ratio = 0.0;
+
+    /** Throttles the most expensive scopes until the estimate fits @allowed_ns */
+    void throttle(double overhead_ns, double allowed_ns) {
+        std::vector<budget_scope_t*> sorted;
+        for (budget_scope_t * scope: m_scopes) {
+            if (!scope->m_disabled) {
+                sorted.push_back(scope);
+            }
+        }
+        std::sort(sorted.begin(), sorted.end(), [] (const budget_scope_t* s1, const budget_scope_t* s2) {
+            bool fine1 = s1->m_level == level_t::fine;
+            bool fine2 = s2->m_level == level_t::fine;
+            return fine1 != fine2 ? fine1 : s1->m_overhead_ns > s2->m_overhead_ns;
+        });
+
+        for (budget_scope_t * scope: sorted) {
+            if (overhead_ns <= allowed_ns) {
+                break;
+            }
+
+            /* Scale the period so the scope alone would cover the excess */
+            double excess_ns = overhead_ns - allowed_ns;
+            double remaining_ns = std::max(scope->m_overhead_ns - excess_ns, 0.0);
+            double factor = remaining_ns > 0.0 ? std::max(scope->m_overhead_ns / remaining_ns, 2.0) : std::numeric_limits<double>::infinity();
+            double period = std::ceil(scope->period() * factor);
+
+            if (scope->m_level == level_t::fine || period > m_options.max_period) {
+                scope->m_disabled = true;
+                scope->set_period(std::numeric_limits<uint32_t>::max(), true);
+                overhead_ns -= scope->m_overhead_ns;
+            } else {
+                scope->set_period(static_cast<uint32_t>(period), true);
+                overhead_ns -= scope->m_overhead_ns - scope->m_overhead_ns / factor;
+            }
+        }
+    }
+
+    /** @brief Halves the period of the throttled scopes, down to their
+     *         initial period, and enables the disabled scopes at max_period
+     */
+    void relax() {
+        for (budget_scope_t * scope: m_scopes) {
+            if (scope->m_disabled) {
+                scope->m_disabled = false;
+                scope->set_period(std::max(m_options.max_period, scope->m_initial_period), true);
+            } else if (scope->period() > scope->m_initial_period) {
+                scope->set_period(std::max(scope->period() / 2, scope->m_initial_period));
+            }
+        }
+    }
+};
+
+/** @brief RAII wrapper measuring time of a budget scope: a sampled scope
+ *         (see sampled_measure_time_t) whose period is set by the controller.
+ */
+template <typename LabelType>
+class budget_measure_time_t: public sampled_measure_time_t<LabelType> {
+public:
+    using recorder_type = typename sampled_measure_time_t<LabelType>::recorder_type;
+
+    budget_measure_time_t(const LabelType& label, recorder_type * recorder, budget_scope_t& scope, budget_controller_t * controller) :
+        sampled_measure_time_t<LabelType>(label, recorder, scope, scope.level())
+    {
+        if (!scope.registered()) {
+            controller->add(&scope);
+        }
+    }
+};
+
+}
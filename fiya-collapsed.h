@@ -0,0 +1,286 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "fiya-recorder.h"
+
+namespace fiya {
+
+/** @brief Read-only memory mapping of a whole file. Pages already parsed
+ *         can be released with release(), so parsing a multi-GB file keeps
+ *         a bounded resident size.
+ */
+class mapped_file_t {
+public:
+    mapped_file_t() :
+        m_data(nullptr),
+        m_size(0U) {}
+
+    ~mapped_file_t() {
+        unmap();
+    }
+
+    mapped_file_t(const mapped_file_t&) = delete;
+    mapped_file_t& operator=(const mapped_file_t&) = delete;
+
+    /** Maps the file @path, returns false on error */
+    bool map(const char * path) {
+        unmap();
+        int fd = open(path, O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            close(fd);
+            return false;
+        }
+        m_size = static_cast<size_t>(st.st_size);
+        if (m_size > 0) {
+            void * data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data == MAP_FAILED) {
+                close(fd);
+                m_size = 0U;
+                return false;
+            }
+            m_data = static_cast<const char*>(data);
+            madvise(data, m_size, MADV_SEQUENTIAL);
+        }
+        close(fd);
+        return true;
+    }
+
+    void unmap() {
+        if (m_data != nullptr) {
+            munmap(const_cast<char*>(m_data), m_size);
+        }
+        m_data = nullptr;
+        m_size = 0U;
+    }
+
+    /** @brief Releases the pages before @end from memory. They are read
+     *         again from the file if accessed.
+     */
+    void release(size_t end) {
+        size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        end = end / page * page;
+        if (m_data != nullptr && end > 0) {
+            madvise(const_cast<char*>(m_data), std::min(end, m_size), MADV_DONTNEED);
+        }
+    }
+
+    const char * data() const {
+        return m_data;
+    }
+
+    size_t size() const {
+        return m_size;
+    }
+private:
+    const char * m_data;
+    size_t m_size;
+};
+
+/** Statistics of parsing collapsed stacks */
+struct collapsed_parse_result_t {
+    /** Number of stacks parsed */
+    uint64_t lines = 0;
+    /** Number of lines without a value, skipped */
+    uint64_t malformed = 0;
+    /** Number of files that couldn't be read */
+    uint64_t failed_files = 0;
+
+    collapsed_parse_result_t& operator+=(const collapsed_parse_result_t& other) {
+        lines += other.lines;
+        malformed += other.malformed;
+        failed_files += other.failed_files;
+        return *this;
+    }
+};
+
+/** Options of parsing collapsed stacks */
+struct collapsed_parse_options_t {
+    /** @brief The first frame of each stack is the root, as in the output of
+     *         recorder_t::to_collapsed_stacks; it is merged into the root of the
+     *         recorder. Otherwise all frames are put under the root.
+     */
+    bool root_frame = true;
+    /** Parsed pages are released from memory every this many bytes */
+    size_t release_bytes = 64U << 20;
+};
+
+/** @brief Parses collapsed stacks, "frame;frame;frame value" per line, and
+ *         adds the values to @recorder. The frames are interned in the
+ *         recorder's string_db_t. Consecutive lines usually share a prefix,
+ *         so only the frames after the common prefix are looked up.
+ *
+ *  @param data   Text to parse
+ *  @param size   Size of the text
+ *  @param file   If given, the mapping of @data, whose parsed pages are released
+ */
+inline collapsed_parse_result_t parse_collapsed_stacks(
+    const char * data,
+    size_t size,
+    recorder_t<const char*, uint64_t>& recorder,
+    const collapsed_parse_options_t& options = collapsed_parse_options_t(),
+    mapped_file_t * file = nullptr)
+{
+    collapsed_parse_result_t result;
+    /* Frames of the open scopes, pointing into @data */
+    std::vector<std::pair<const char*, size_t>> open;
+    std::vector<std::pair<const char*, size_t>> frames;
+    std::string frame;
+    size_t next_release { options.release_bytes };
+
+    const char * end = data + size;
+    for (const char * line = data; line < end; ) {
+        const char * line_end = static_cast<const char*>(memchr(line, '\n', static_cast<size_t>(end - line)));
+        if (line_end == nullptr) {
+            line_end = end;
+        }
+        const char * next = line_end < end ? line_end + 1 : end;
+        if (line_end > line && line_end[-1] == '\r') {
+            line_end--;
+        }
+
+        /* The value is after the last space */
+        const char * space = line_end;
+        while (space > line && space[-1] != ' ') {
+            space--;
+        }
+        uint64_t value { 0U };
+        bool valid = space > line + 1 && space < line_end;
+        for (const char * c = space; valid && c < line_end; c++) {
+            if (*c < '0' || *c > '9') {
+                valid = false;
+            } else {
+                value = value * 10 + static_cast<uint64_t>(*c - '0');
+            }
+        }
+        if (!valid) {
+            if (line_end > line) {
+                result.malformed++;
+            }
+            line = next;
+            continue;
+        }
+
+        frames.clear();
+        const char * frames_end = space - 1;
+        for (const char * f = line; f <= frames_end; ) {
+            const char * semicolon = static_cast<const char*>(memchr(f, ';', static_cast<size_t>(frames_end - f)));
+            if (semicolon == nullptr) {
+                semicolon = frames_end;
+            }
+            frames.emplace_back(f, static_cast<size_t>(semicolon - f));
+            f = semicolon + 1;
+        }
+        size_t first { options.root_frame ? 1U : 0U };
+
+        /* Keep the common prefix with the previous line open */
+        size_t common { 0U };
+        while (common < open.size() && first + common < frames.size() &&
+               open[common].second == frames[first + common].second &&
+               memcmp(open[common].first, frames[first + common].first, open[common].second) == 0) {
+            common++;
+        }
+        for (size_t i { open.size() }; i > common; i--) {
+            recorder.end_scope();
+        }
+        open.resize(common);
+        for (size_t i { first + common }; i < frames.size(); i++) {
+            frame.assign(frames[i].first, frames[i].second);
+            recorder.begin_scope(frame.c_str());
+            open.push_back(frames[i]);
+        }
+        recorder.cnt() += value;
+        result.lines++;
+
+        line = next;
+        if (file != nullptr && static_cast<size_t>(line - data) >= next_release) {
+            /* The open frames point into earlier lines, which stay mapped */
+            file->release(static_cast<size_t>((open.empty() ? line : open.front().first) - data));
+            next_release = static_cast<size_t>(line - data) + options.release_bytes;
+        }
+    }
+
+    for (size_t i { open.size() }; i > 0; i--) {
+        recorder.end_scope();
+    }
+    return result;
+}
+
+/** @brief Maps the file @path and parses its collapsed stacks into @recorder */
+inline collapsed_parse_result_t parse_collapsed_file(
+    const char * path,
+    recorder_t<const char*, uint64_t>& recorder,
+    const collapsed_parse_options_t& options = collapsed_parse_options_t())
+{
+    mapped_file_t file;
+    if (!file.map(path)) {
+        collapsed_parse_result_t result;
+        result.failed_files = 1;
+        return result;
+    }
+    return parse_collapsed_stacks(file.data(), file.size(), recorder, options, &file);
+}
+
+/** @brief Parses and merges the collapsed stack files @paths into @result,
+ *         with @threads threads (0 is one per core). Each thread parses one
+ *         file at a time into a tree of its own, so the memory is bounded by
+ *         the number of distinct stacks times the threads, regardless of the
+ *         number and size of the files. The trees are merged at the end.
+ */
+inline collapsed_parse_result_t merge_collapsed_files(
+    const std::vector<std::string>& paths,
+    recorder_t<const char*, uint64_t>& result,
+    size_t threads = 0,
+    const collapsed_parse_options_t& options = collapsed_parse_options_t())
+{
+    if (threads == 0) {
+        threads = std::max(1U, std::thread::hardware_concurrency());
+    }
+    threads = std::max<size_t>(std::min(threads, paths.size()), 1U);
+
+    std::atomic<size_t> next_path { 0U };
+    std::vector<std::unique_ptr<recorder_t<const char*, uint64_t>>> recorders;
+    std::vector<collapsed_parse_result_t> results(threads);
+    for (size_t t { 0U }; t < threads; t++) {
+        recorders.emplace_back(new recorder_t<const char*, uint64_t>(0U, "root", 0U));
+    }
+
+    auto worker = [&] (size_t t) {
+        for (size_t i = next_path++; i < paths.size(); i = next_path++) {
+            results[t] += parse_collapsed_file(paths[i].c_str(), *recorders[t], options);
+        }
+    };
+    std::vector<std::thread> pool;
+    for (size_t t { 1U }; t < threads; t++) {
+        pool.emplace_back(worker, t);
+    }
+    worker(0U);
+    for (std::thread& thread : pool) {
+        thread.join();
+    }
+
+    collapsed_parse_result_t total;
+    for (size_t t { 0U }; t < threads; t++) {
+        result.merge(*recorders[t]);
+        total += results[t];
+    }
+    return total;
+}
+
+}
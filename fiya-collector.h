@@ -0,0 +1,395 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <functional>
+#include <unordered_map>
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/un.h>
+#include <sys/socket.h>
+
+#include "fiya-recorder.h"
+
+namespace fiya {
+
+namespace detail {
+
+/** Keeps a parameter out of template argument deduction, so lambdas can be passed */
+template <typename T>
+struct non_deduced {
+    using type = T;
+};
+
+}
+
+/** @brief Encoder of profile deltas into the datagram format of the
+ *         collector:
+ *    - the magic "FYD" and the version 1,
+ *    - the binary name and the tag, each as a varint length and the bytes,
+ *    - per path: the number of frames shared with the previous path, the
+ *      number of new frames, the new frames and the delta, as varints.
+ *      A frame is a varint v: an index v >> 1 into the frames seen in the
+ *      datagram if v is even, else v >> 1 bytes of a new frame follow.
+ *  Paths are expected parents first, as given by recorder_t::for_each_path,
+ *  so consecutive paths share most frames.
+ */
+class delta_encoder_t {
+public:
+    /** Starts a datagram of @binary and @tag */
+    void begin(const std::string& binary, const std::string& tag) {
+        m_data.assign("FYD\1", 4);
+        string_out(binary);
+        string_out(tag);
+        m_previous.clear();
+        m_frames.clear();
+    }
+
+    /** Adds @delta to the path @path */
+    void add(const std::vector<std::string>& path, uint64_t delta) {
+        size_t common { 0U };
+        while (common < m_previous.size() && common < path.size() && m_previous[common] == path[common]) {
+            common++;
+        }
+        varint_out(common);
+        varint_out(path.size() - common);
+        for (size_t i { common }; i < path.size(); i++) {
+            auto it = m_frames.find(path[i]);
+            if (it != m_frames.end()) {
+                varint_out(it->second << 1);
+            } else {
+                varint_out((path[i].size() << 1) | 1U);
+                m_data.append(path[i]);
+                m_frames.emplace(path[i], m_frames.size());
+            }
+        }
+        varint_out(delta);
+        m_previous = path;
+    }
+
+    const std::string& data() const {
+        return m_data;
+    }
+private:
+    std::string m_data;
+    std::vector<std::string> m_previous;
+    /** Index of the frames seen in the datagram */
+    std::unordered_map<std::string, uint64_t> m_frames;
+
+    void varint_out(uint64_t v) {
+        while (v >= 0x80) {
+            m_data.push_back(static_cast<char>(v | 0x80));
+            v >>= 7;
+        }
+        m_data.push_back(static_cast<char>(v));
+    }
+
+    void string_out(const std::string& s) {
+        varint_out(s.size());
+        m_data.append(s);
+    }
+};
+
+/** @brief Decodes a datagram written by delta_encoder_t, calling @visitor
+ *         for every path. Returns false if the datagram is malformed; the
+ *         paths before the error have been visited.
+ */
+inline bool decode_delta(
+    const char * data,
+    size_t size,
+    const std::function<void(const std::string& binary, const std::string& tag, const std::vector<std::string>& path, uint64_t delta)>& visitor)
+{
+    const char * end = data + size;
+    auto varint_in = [&data, end] (uint64_t& v) {
+        v = 0U;
+        for (unsigned shift { 0U }; data < end && shift < 64; shift += 7) {
+            uint8_t byte = static_cast<uint8_t>(*data++);
+            v |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) {
+                return true;
+            }
+        }
+        return false;
+    };
+    auto string_in = [&data, end] (std::string& s, uint64_t length) {
+        if (static_cast<uint64_t>(end - data) < length) {
+            return false;
+        }
+        s.assign(data, length);
+        data += length;
+        return true;
+    };
+
+    if (size < 4 || memcmp(data, "FYD\1", 4) != 0) {
+        return false;
+    }
+    data += 4;
+
+    std::string binary, tag;
+    uint64_t length;
+    if (!varint_in(length) || !string_in(binary, length) || !varint_in(length) || !string_in(tag, length)) {
+        return false;
+    }
+
+    std::vector<std::string> path;
+    std::vector<std::string> frames;
+    while (data < end) {
+        uint64_t common, count, delta;
+        if (!varint_in(common) || !varint_in(count) || common > path.size()) {
+            return false;
+        }
+        path.resize(common);
+        for (uint64_t i { 0U }; i < count; i++) {
+            uint64_t v;
+            if (!varint_in(v)) {
+                return false;
+            }
+            if (v & 1U) {
+                std::string frame;
+                if (!string_in(frame, v >> 1)) {
+                    return false;
+                }
+                frames.push_back(frame);
+                path.push_back(frame);
+            } else if ((v >> 1) < frames.size()) {
+                path.push_back(frames[v >> 1]);
+            } else {
+                return false;
+            }
+        }
+        if (!varint_in(delta)) {
+            return false;
+        }
+        visitor(binary, tag, path, delta);
+    }
+    return true;
+}
+
+/** @brief Client side exporter of profile deltas to the collector
+ *         (tools/fiya-collector) over a Unix domain datagram socket.
+ *
+ *  Each send() sends the change of every path since the last delivered
+ *  send. Sending never blocks: when the collector's socket is full, or the
+ *  collector is not running, the datagram is dropped and its deltas are
+ *  sent again, accumulated, by the next send(). Not thread-safe.
+ */
+class delta_exporter_t {
+public:
+    /** Constructor
+     *
+     *    @param socket_path  Path of the collector's socket
+     *    @param binary       Name of the binary, profiles are merged per binary
+     *    @param max_datagram Maximum size of a datagram, larger deltas are split
+     */
+    delta_exporter_t(const std::string& socket_path, const std::string& binary, size_t max_datagram = 32768) :
+        m_binary(binary),
+        m_max_datagram(max_datagram),
+        m_sent_datagrams(0U),
+        m_dropped_datagrams(0U)
+    {
+        m_fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+        memset(&m_address, 0, sizeof(m_address));
+        m_address.sun_family = AF_UNIX;
+        strncpy(m_address.sun_path, socket_path.c_str(), sizeof(m_address.sun_path) - 1);
+    }
+
+    ~delta_exporter_t() {
+        if (m_fd >= 0) {
+            close(m_fd);
+        }
+    }
+
+    delta_exporter_t(const delta_exporter_t&) = delete;
+    delta_exporter_t& operator=(const delta_exporter_t&) = delete;
+
+    /** @brief Sends the deltas of @recorder under @tag, e.g. each tag of a
+     *         tagged_recorder_t from its for_each_tag. Returns the number of
+     *         datagrams delivered to the socket.
+     *
+     *  @param l_out   Function used to output a label
+     *  @param m_value Function returning the value of a measure, e.g. microseconds.
+     *                 A value smaller than the last sent one is taken as a reset
+     *                 of the recorder and sent whole.
+     */
+    template <typename LabelType, typename MeasureType>
+    size_t send(
+        recorder_t<LabelType, MeasureType>& recorder,
+        const typename detail::non_deduced<std::function<void(std::ostream& os, const LabelType& l)>>::type & l_out,
+        const typename detail::non_deduced<std::function<uint64_t(const MeasureType& m)>>::type & m_value,
+        const std::string& tag = "")
+    {
+        size_t delivered { 0U };
+        std::vector<std::string> path;
+        std::ostringstream label;
+        m_encoder.begin(m_binary, tag);
+        m_pending.clear();
+
+        recorder.for_each_path([&] (const std::vector<LabelType>& labels, const MeasureType& m) {
+            path.clear();
+            std::string key { tag };
+            for (const LabelType& l : labels) {
+                label.str("");
+                l_out(label, l);
+                path.push_back(label.str());
+                key.push_back('\n');
+                key.append(path.back());
+            }
+
+            uint64_t value = m_value(m);
+            uint64_t& sent = m_sent[key];
+            uint64_t delta = value >= sent ? value - sent : value;
+            if (delta == 0) {
+                return;
+            }
+            m_encoder.add(path, delta);
+            m_pending.emplace_back(&sent, value);
+
+            if (m_encoder.data().size() >= m_max_datagram) {
+                delivered += flush(tag);
+            }
+        });
+        delivered += flush(tag);
+        return delivered;
+    }
+
+    /** Returns the number of delivered datagrams */
+    uint64_t sent_datagrams() const {
+        return m_sent_datagrams;
+    }
+
+    /** Returns the number of dropped datagrams */
+    uint64_t dropped_datagrams() const {
+        return m_dropped_datagrams;
+    }
+private:
+    int m_fd;
+    struct sockaddr_un m_address;
+    std::string m_binary;
+    size_t m_max_datagram;
+    delta_encoder_t m_encoder;
+    /** Last delivered value of each path, by tag and path */
+    std::unordered_map<std::string, uint64_t> m_sent;
+    /** Values of the datagram being encoded, stored when it is delivered */
+    std::vector<std::pair<uint64_t*, uint64_t>> m_pending;
+    uint64_t m_sent_datagrams;
+    uint64_t m_dropped_datagrams;
+
+    /** Sends the datagram being encoded, returns 1 if delivered */
+    size_t flush(const std::string& tag) {
+        if (m_pending.empty()) {
+            return 0U;
+        }
+        const std::string& data = m_encoder.data();
+        ssize_t result = sendto(m_fd, data.data(), data.size(), MSG_DONTWAIT,
+                                reinterpret_cast<const struct sockaddr*>(&m_address), sizeof(m_address));
+        size_t delivered { 0U };
+        if (result == static_cast<ssize_t>(data.size())) {
+            for (auto& pending : m_pending) {
+                *pending.first = pending.second;
+            }
+            m_sent_datagrams++;
+            delivered = 1U;
+        } else {
+            m_dropped_datagrams++;
+        }
+        m_pending.clear();
+        m_encoder.begin(m_binary, tag);
+        return delivered;
+    }
+};
+
+/** @brief Merges the deltas received by the collector into one recorder
+ *         per binary and tag.
+ *
+ *  The root of a recorder is the first frame of the first path received for
+ *  its binary and tag. Paths with another first frame, e.g. from a process
+ *  that names its root differently, are kept below that root instead of
+ *  being merged into it.
+ */
+class delta_collector_t {
+public:
+    using recorder_type = recorder_t<const char*, uint64_t>;
+
+    /** Merges a datagram, returns false if it is malformed */
+    bool add_datagram(const char * data, size_t size) {
+        return decode_delta(data, size, [this] (const std::string& binary, const std::string& tag,
+                                                const std::vector<std::string>& path, uint64_t delta) {
+            profile_t& profile = m_recorders[std::make_pair(binary, tag)];
+            if (!profile.recorder) {
+                profile.root = path.empty() ? "root" : path[0];
+                profile.recorder.reset(new recorder_type(0U, profile.root.c_str(), 0U));
+            }
+            recorder_type& recorder = *profile.recorder;
+            /* The first frame is the root, unless it names another one */
+            size_t first = path.empty() || path[0] == profile.root ? 1U : 0U;
+            for (size_t i { first }; i < path.size(); i++) {
+                recorder.begin_scope(path[i].c_str());
+            }
+            recorder.cnt() += delta;
+            for (size_t i { first }; i < path.size(); i++) {
+                recorder.end_scope();
+            }
+        });
+    }
+
+    /** Calls @visitor for the recorder of each binary and tag */
+    void for_each(const std::function<void(const std::string& binary, const std::string& tag, recorder_type& recorder)>& visitor) {
+        for (auto& entry : m_recorders) {
+            visitor(entry.first.first, entry.first.second, *entry.second.recorder);
+        }
+    }
+
+    /** @brief Writes the profile of each binary and tag in the collapsed stack
+     *         format to @directory, in files named binary.txt or binary.tag.txt.
+     *         Returns false if a file couldn't be written.
+     */
+    bool write(const std::string& directory) {
+        bool ok { true };
+        for_each([&] (const std::string& binary, const std::string& tag, recorder_type& recorder) {
+            std::string name { directory + "/" + file_name(binary) };
+            if (!tag.empty()) {
+                name += "." + file_name(tag);
+            }
+            std::string temporary { name + ".tmp" };
+            {
+                std::ofstream file(temporary);
+                recorder.to_collapsed_stacks(file,
+                    [] (std::ostream& os, const char* const & l) { os << l; },
+                    [] (std::ostream& os, const uint64_t& m) { os << m; });
+                ok = ok && file.good();
+            }
+            /* Readers never see a partially written profile */
+            ok = ok && rename(temporary.c_str(), (name + ".txt").c_str()) == 0;
+        });
+        return ok;
+    }
+private:
+    struct profile_t {
+        /** First frame of the first path, the label of the root */
+        std::string root;
+        std::unique_ptr<recorder_type> recorder;
+    };
+
+    /** Profiles by binary and tag */
+    std::map<std::pair<std::string, std::string>, profile_t> m_recorders;
+
+    /** Replaces the characters that can't be in a file name */
+    static std::string file_name(std::string s) {
+        for (char& c : s) {
+            if (c == '/' || c == '\0') {
+                c = '_';
+            }
+        }
+        return s;
+    }
+};
+
+}
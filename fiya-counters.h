@@ -0,0 +1,161 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <ostream>
+#include <stdexcept>
+#include <functional>
+
+#include "fiya-string-db.h"
+#include "fiya-time-measure.h"
+
+namespace fiya {
+
+/** Identifier of a user defined counter, an index into counted_time_value_t::counters */
+using counter_id_t = size_t;
+
+/** @brief Registry of user defined counter names, e.g. "rows processed"
+ *         or "bytes parsed".
+ *
+ *  Counters are identified by a small index so the nodes of the
+ *  recorder only need an array of N integers.
+ */
+template <size_t N>
+class counter_registry_t {
+public:
+    /** @brief Registers a counter name and returns its id. Registering
+     *         the same name again returns the same id.
+     *
+     *  @throws std::length_error if more than N counters are registered.
+     */
+    counter_id_t register_counter(const char * name) {
+        for (counter_id_t id { 0U }; id < m_names.size(); id++) {
+            if (strcmp(m_string_db.get(m_names[id]), name) == 0) {
+                return id;
+            }
+        }
+
+        if (m_names.size() == N) {
+            throw std::length_error("fiya::counter_registry_t is full");
+        }
+
+        m_names.push_back(m_string_db.push_back(name));
+        return m_names.size() - 1;
+    }
+
+    /** Returns the name of a registered counter */
+    const char * name(counter_id_t id) const {
+        return m_string_db.get(m_names[id]);
+    }
+
+    /** Returns the number of registered counters */
+    size_t size() const {
+        return m_names.size();
+    }
+private:
+    /** Storage for the counter names */
+    string_db_t m_string_db { 256 };
+    /** Index of each name in m_string_db */
+    std::vector<size_t> m_names;
+};
+
+/** @brief Time value extended with N user defined counters, so the
+ *         time and the counters are recorded in the same tree.
+ */
+template <size_t N>
+class counted_time_value_t: public time_value_t {
+public:
+    /** Values of the counters, indexed by counter_id_t */
+    std::array<uint64_t, N> counters {};
+
+    static counted_time_value_t now() {
+        counted_time_value_t result;
+        static_cast<time_value_t&>(result) = time_value_t::now();
+        return result;
+    }
+
+    counted_time_value_t operator+(const counted_time_value_t& other) const {
+        counted_time_value_t result;
+        static_cast<time_value_t&>(result) = time_value_t::operator+(other);
+        for (size_t i { 0U }; i < N; i++) {
+            result.counters[i] = counters[i] + other.counters[i];
+        }
+        return result;
+    }
+};
+
+/** RAII wrapper for measuring time together with N user defined counters. */
+template <typename LabelType, size_t N>
+using measure_counted_time_t = measure_time_t<LabelType, counted_time_value_t<N>>;
+
+/** @brief Adds @value to the counter @id of the current scope. */
+template <size_t N>
+inline void add_counter(counter_interface_t<counted_time_value_t<N>> * recorder, counter_id_t id, uint64_t value) {
+    recorder->cnt().counters[id] += value;
+}
+
+/** @brief Returns a function that outputs the counter @id. Pass it to
+ *         recorder_t::to_collapsed_stacks to get the flamegraph of the counter.
+ */
+template <size_t N>
+std::function<void(std::ostream& os, const counted_time_value_t<N>& m)> counter_out(counter_id_t id) {
+    return [id] (std::ostream& os, const counted_time_value_t<N>& m) {
+        os << m.counters[id];
+    };
+}
+
+/** @brief Writes the per path throughput table. For each path that
+ *         has a non-zero counter, writes a tab separated line with
+ *         the path, the self time in microseconds and, for each registered
+ *         counter, its value and its rate per CPU second of self time.
+ *
+ *  @param recorder Recorder holding time and counters
+ *  @param registry Registry with the counter names, used for the header line
+ *  @param os       Output stream where to write the result
+ *  @param l_out    Function used to output the label type to output stream
+ */
+template <typename LabelType, size_t N>
+void to_throughput_table(
+    recorder_t<LabelType, counted_time_value_t<N>>& recorder,
+    const counter_registry_t<N>& registry,
+    std::ostream& os,
+    const std::function<void(std::ostream& os, const LabelType& l)> & l_out)
+{
+    os << "path\tself_us";
+    for (counter_id_t id { 0U }; id < registry.size(); id++) {
+        os << "\t" << registry.name(id) << "\t" << registry.name(id) << "/s";
+    }
+    os << "\n";
+
+    recorder.for_each_path([&] (const std::vector<LabelType>& path, const counted_time_value_t<N>& value) {
+        bool has_counters = false;
+        for (counter_id_t id { 0U }; id < registry.size(); id++) {
+            has_counters = has_counters || value.counters[id] != 0;
+        }
+        if (!has_counters) {
+            return;
+        }
+
+        for (size_t i { 0U }; i < path.size(); i++) {
+            if (i > 0) {
+                os << ";";
+            }
+            l_out(os, path[i]);
+        }
+
+        std::chrono::duration<double> self = value.get_duration();
+        os << "\t" << std::chrono::duration_cast<std::chrono::microseconds>(value.get_duration()).count();
+        for (counter_id_t id { 0U }; id < registry.size(); id++) {
+            os << "\t" << value.counters[id] << "\t";
+            if (self.count() > 0.0) {
+                os << static_cast<double>(value.counters[id]) / self.count();
+            } else {
+                os << "-";
+            }
+        }
+        os << "\n";
+    });
+}
+
+}
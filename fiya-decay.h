@@ -0,0 +1,186 @@
+#pragma once
+
+#include <cmath>
+#include <chrono>
+#include <vector>
+#include <cstdint>
+#include <ostream>
+#include <algorithm>
+#include <functional>
+
+#include "fiya-time-measure.h"
+
+namespace fiya {
+
+/** @brief Exponential decay with a given half-life. Time is divided into
+ *         epochs, a fixed fraction of the half-life, and values decay by
+ *         whole epochs.
+ */
+class decay_t {
+public:
+    /** Constructor
+     *
+     *    @param half_life             Time after which a value has decayed to half
+     *    @param epochs_per_half_life  Resolution of the decay
+     */
+    decay_t(std::chrono::steady_clock::duration half_life, uint32_t epochs_per_half_life = 16) :
+        m_epoch_length(std::max<std::chrono::steady_clock::duration::rep>(half_life.count() / epochs_per_half_life, 1)),
+        m_start(std::chrono::steady_clock::now())
+    {
+        /* After 64 half-lives a value is below 1e-19 of the original, treat it as zero */
+        m_factors.resize(64 * epochs_per_half_life);
+        for (size_t i { 0U }; i < m_factors.size(); i++) {
+            m_factors[i] = std::exp2(-static_cast<double>(i) / epochs_per_half_life);
+        }
+    }
+
+    /** Returns the current epoch */
+    uint32_t epoch() const {
+        return static_cast<uint32_t>((std::chrono::steady_clock::now() - m_start) / m_epoch_length);
+    }
+
+    /** Returns the factor a value decays by in @epochs epochs */
+    double factor(uint32_t epochs) const {
+        return epochs < m_factors.size() ? m_factors[epochs] : 0.0;
+    }
+
+    /** Returns the length of an epoch */
+    std::chrono::steady_clock::duration epoch_length() const {
+        return m_epoch_length;
+    }
+private:
+    /** Length of an epoch */
+    std::chrono::steady_clock::duration m_epoch_length;
+    /** Time of epoch 0 */
+    std::chrono::steady_clock::time_point m_start;
+    /** Decay factor for each number of elapsed epochs */
+    std::vector<double> m_factors;
+};
+
+/** @brief Exponentially decayed value. The decay is applied lazily: the
+ *         value is stored with the epoch of its last update, and decayed
+ *         to the current epoch when it is read or updated.
+ */
+struct decayed_value_t {
+    double value;
+    uint32_t epoch;
+
+    decayed_value_t() :
+        value(0.0),
+        epoch(0U) {}
+
+    /** @brief Decays the value to the epoch @now and adds @amount. If the
+     *         value was updated after @now, e.g. by another thread after
+     *         the caller took @now, @amount is decayed to the value's epoch.
+     */
+    void add(double amount, uint32_t now, const decay_t& decay) {
+        if (now < epoch) {
+            value += amount * decay.factor(epoch - now);
+            return;
+        }
+        value = value * decay.factor(now - epoch) + amount;
+        epoch = now;
+    }
+
+    /** @brief Returns the value decayed to the epoch @now, undecayed if it
+     *         was updated after @now.
+     */
+    double read(uint32_t now, const decay_t& decay) const {
+        return now < epoch ? value : value * decay.factor(now - epoch);
+    }
+};
+
+/** @brief Time value decaying exponentially, in nanoseconds of CPU time.
+ *         Recorded by measure_decayed_time_t.
+ */
+struct decayed_time_value_t {
+    /** Decayed self time in nanoseconds */
+    decayed_value_t ns;
+    /** Thread time when the node's time last started running */
+    std::chrono::time_point<std::chrono::high_resolution_clock> start;
+
+    static decayed_time_value_t now() {
+        decayed_time_value_t result;
+        result.start = get_thread_time<void>();
+        return result;
+    }
+};
+
+/** @brief Adds @amount to the decayed counter of the current scope,
+ *         e.g. for events recorded outside of the RAII wrappers.
+ */
+inline void add_decayed(counter_interface_t<decayed_value_t> * recorder, double amount, const decay_t& decay) {
+    recorder->cnt().add(amount, decay.epoch(), decay);
+}
+
+/** @brief Decays the values of @src and @dst to the current epoch and adds
+ *         @src to @dst. Pass it to recorder_t::merge to merge decayed
+ *         recorders, e.g. of different threads.
+ */
+inline std::function<void(decayed_value_t& dst, const decayed_value_t& src)> decayed_merge(const decay_t& decay) {
+    uint32_t now = decay.epoch();
+    return [&decay, now] (decayed_value_t& dst, const decayed_value_t& src) {
+        dst.add(src.read(now, decay), now, decay);
+    };
+}
+
+/** @brief RAII wrapper for measuring time with exponential decay, so the
+ *         tree reflects the recent behavior: time recorded one half-life ago
+ *         counts half. A decayed self time divided by half_life / ln(2) is
+ *         the recent fraction of CPU time spent in the scope.
+ */
+template <typename LabelType>
+class measure_decayed_time_t {
+public:
+    using measure_type = decayed_time_value_t;
+    using recorder_type = recorder_t<LabelType, measure_type>;
+
+    measure_decayed_time_t(const LabelType& label, recorder_type * recorder, const decay_t * decay) :
+        m_recorder(recorder),
+        m_decay(decay)
+    {
+        add_elapsed();
+        m_recorder->begin_scope(label);
+        m_recorder->cnt().start = get_thread_time<void>();
+    }
+
+    ~measure_decayed_time_t() {
+        add_elapsed();
+        m_recorder->end_scope();
+        m_recorder->cnt().start = get_thread_time<void>();
+    }
+private:
+    /** Pointer to the recorder */
+    recorder_type * m_recorder;
+    /** Decay of the recorded values */
+    const decay_t * m_decay;
+
+    /** Adds the time since the current scope started running */
+    void add_elapsed() {
+        decayed_time_value_t& value = m_recorder->cnt();
+        double ns = std::chrono::duration<double, std::nano>(get_thread_time<void>() - value.start).count();
+        value.ns.add(ns, m_decay->epoch(), *m_decay);
+    }
+};
+
+/** @brief Returns a function that outputs the decayed value at the time of
+ *         the call. Pass it to recorder_t::to_collapsed_stacks.
+ */
+inline std::function<void(std::ostream& os, const decayed_value_t& m)> decayed_out(const decay_t& decay) {
+    uint32_t now = decay.epoch();
+    return [&decay, now] (std::ostream& os, const decayed_value_t& m) {
+        os << static_cast<uint64_t>(m.read(now, decay) + 0.5);
+    };
+}
+
+/** @brief Returns a function that outputs the decayed time in microseconds
+ *         at the time of the call. Pass it to recorder_t::to_collapsed_stacks.
+ */
+inline std::function<void(std::ostream& os, const decayed_time_value_t& m)> decayed_time_out(const decay_t& decay) {
+    uint32_t now = decay.epoch();
+    return [&decay, now] (std::ostream& os, const decayed_time_value_t& m) {
+        os << static_cast<uint64_t>(m.ns.read(now, decay) / 1000.0 + 0.5);
+    };
+}
+
+}
@@ -0,0 +1,377 @@
+#pragma once
+
+#include <chrono>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <functional>
+
+#include "fiya-recorder.h"
+
+namespace fiya {
+
+/** Kind of a record of event_log_t */
+enum class log_kind_t : uint8_t {
+    /** Scope begins, with its label */
+    begin,
+    /** Scope ends, with the duration in nanoseconds summed over all the
+     *  iterations the record stands for */
+    end,
+    /** The previous @period sibling scopes repeat @value more times */
+    repeat
+};
+
+/** Record of event_log_t */
+template <typename LabelType>
+struct log_record_t {
+    log_kind_t kind;
+    /** Number of repeated siblings, for repeat records */
+    uint32_t period;
+    /** Label, in the internal representation, for begin records */
+    LabelType label;
+    /** Duration in nanoseconds for end records, repeat count for repeat records */
+    uint64_t value;
+};
+
+/** Event of the decoded log, see event_log_t::for_each_event */
+template <typename LabelType>
+struct log_event_t {
+    log_kind_t kind;
+    const LabelType& label;
+    /** Depth of the scope, 1 for top level scopes */
+    size_t depth;
+    /** @brief For end events: the duration summed over all iterations the
+     *         scope stands for, and their number. The compressed log only keeps
+     *         the sum, each expanded iteration has the average duration.
+     */
+    uint64_t total_ns;
+    uint64_t iterations;
+};
+
+/** @brief Log of scope begin/end events, run-length compressed on the fly.
+ *
+ *  When a scope ends, the sequence of the last @period (up to MaxPeriod)
+ *  completed sibling scopes is compared with the sequence just before it.
+ *  If both have the same structure, i.e. the same labels, nesting and
+ *  repeat counts, the new sequence is dropped: its durations are added to
+ *  the records of the first one, followed by a repeat record with the count.
+ *  Further iterations only increment the count, so a loop of any number of
+ *  iterations takes the records of one iteration plus one repeat record,
+ *  and the order of the sibling scopes is preserved.
+ *
+ *  The log keeps the durations summed per scope of the pattern, which is
+ *  exact for the aggregated data: to_recorder() gives the same totals as
+ *  the uncompressed events would. Like recorder_t, it is not thread-safe,
+ *  use one per thread.
+ */
+template <typename LabelType, size_t MaxPeriod = 4>
+class event_log_t {
+public:
+    static_assert(MaxPeriod > 0, "The period needs to be at least one");
+
+    using record_type = log_record_t<LabelType>;
+
+    event_log_t() :
+        m_start(std::chrono::steady_clock::now()),
+        m_frames(1) {}
+
+    /** Begins a scope with @label */
+    void begin(const LabelType& label) {
+        begin_at(label, now_ns());
+    }
+
+    /** Ends the current scope */
+    void end() {
+        end_at(now_ns());
+    }
+
+    /** Begins a scope with @label at the time @ns, e.g. of an external clock */
+    void begin_at(const LabelType& label, uint64_t ns) {
+        m_frames.push_back(frame_t{ m_records.size(), ns, {} });
+        m_records.push_back(record_type{ log_kind_t::begin, 0U, m_label_helper.save(label), 0U });
+    }
+
+    /** Ends the current scope at the time @ns */
+    void end_at(uint64_t ns) {
+        if (m_frames.size() == 1) {
+            return;
+        }
+        frame_t& frame = m_frames.back();
+        size_t begin = frame.begin;
+        m_records.push_back(record_type{ log_kind_t::end, 0U, LabelType{}, ns - std::min(ns, frame.start_ns) });
+        m_frames.pop_back();
+
+        m_frames.back().items.push_back(begin);
+        compress(m_frames.back());
+    }
+
+    /** Returns the number of records */
+    size_t size() const {
+        return m_records.size();
+    }
+
+    /** Returns the records */
+    const std::vector<record_type>& records() const {
+        return m_records;
+    }
+
+    /** Returns the number of begin and end events of the completed top level scopes */
+    uint64_t event_count() const {
+        return count_events(0U, top_level_end());
+    }
+
+    /** @brief Calls @visitor for every begin and end event in the original
+     *         order, expanding the repeats. Only completed top level scopes
+     *         are visited.
+     */
+    void for_each_event(const std::function<void(const log_event_t<LabelType>& event)>& visitor) const {
+        expand(0U, top_level_end(), 1U, 1U, visitor);
+    }
+
+    /** @brief Adds the self time of the completed scopes to @recorder, e.g.
+     *         for a flamegraph. The totals are exact.
+     */
+    void to_recorder(recorder_t<LabelType, uint64_t>& recorder) const {
+        size_t end = top_level_end();
+        /* Durations of the children of the open scopes */
+        std::vector<uint64_t> children { 0U };
+        for (size_t i { 0U }; i < end; i++) {
+            const record_type& r = m_records[i];
+            if (r.kind == log_kind_t::begin) {
+                recorder.begin_scope(m_label_helper.restore(r.label));
+                children.push_back(0U);
+            } else if (r.kind == log_kind_t::end) {
+                recorder.cnt() += r.value - std::min(r.value, children.back());
+                recorder.end_scope();
+                children.pop_back();
+                children.back() += r.value;
+            }
+        }
+    }
+private:
+    /** Open scope */
+    struct frame_t {
+        /** Index of the begin record */
+        size_t begin;
+        /** Time when the scope began */
+        uint64_t start_ns;
+        /** @brief Indices of the first records of the last completed children,
+         *         each a scope or a repeat record. At most 2 * MaxPeriod + 1 are kept.
+         */
+        std::vector<size_t> items;
+    };
+
+    label_helper<LabelType> m_label_helper;
+    std::chrono::steady_clock::time_point m_start;
+    std::vector<record_type> m_records;
+    /** Open scopes, the first is the top level */
+    std::vector<frame_t> m_frames;
+
+    uint64_t now_ns() const {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - m_start).count());
+    }
+
+    /** Returns the end of item @i of @frame */
+    size_t item_end(const frame_t& frame, size_t i) const {
+        return i + 1 < frame.items.size() ? frame.items[i + 1] : m_records.size();
+    }
+
+    bool is_repeat(const frame_t& frame, size_t i) const {
+        return m_records[frame.items[i]].kind == log_kind_t::repeat;
+    }
+
+    /** Returns true if the records from @a and from @b have the same structure */
+    bool same_structure(size_t a, size_t b, size_t length) const {
+        for (size_t i { 0U }; i < length; i++) {
+            const record_type& ra = m_records[a + i];
+            const record_type& rb = m_records[b + i];
+            if (ra.kind != rb.kind ||
+                (ra.kind == log_kind_t::begin && !(ra.label == rb.label)) ||
+                (ra.kind == log_kind_t::repeat && (ra.period != rb.period || ra.value != rb.value))) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /** @brief Returns true if the repeats among the @period items from item
+     *         @a only cover items in this range
+     */
+    bool self_contained(const frame_t& frame, size_t a, size_t period) const {
+        for (size_t k { 0U }; k < period; k++) {
+            if (is_repeat(frame, a + k) && m_records[frame.items[a + k]].period > k) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /** @brief Returns true if the @period items from item @b have the same
+     *         structure as the @period items from item @a
+     */
+    bool same_items(const frame_t& frame, size_t a, size_t b, size_t period) const {
+        size_t a_begin = frame.items[a];
+        size_t b_begin = frame.items[b];
+        size_t length = item_end(frame, a + period - 1) - a_begin;
+        if (item_end(frame, b + period - 1) - b_begin != length || !self_contained(frame, a, period)) {
+            return false;
+        }
+        return same_structure(a_begin, b_begin, length);
+    }
+
+    /** @brief Drops the @period items from item @b, adding their durations
+     *         to the items from @a, which have the same structure
+     */
+    void fold(frame_t& frame, size_t a, size_t b) {
+        size_t a_begin = frame.items[a];
+        size_t b_begin = frame.items[b];
+        for (size_t i { 0U }; b_begin + i < m_records.size(); i++) {
+            if (m_records[a_begin + i].kind == log_kind_t::end) {
+                m_records[a_begin + i].value += m_records[b_begin + i].value;
+            }
+        }
+        m_records.resize(b_begin);
+        frame.items.resize(b);
+    }
+
+    /** Compresses the last children of @frame */
+    void compress(frame_t& frame) {
+        size_t n = frame.items.size();
+        for (size_t period { 1U }; period <= MaxPeriod; period++) {
+            /* One more iteration of an existing repeat */
+            if (n >= 2 * period + 1 && is_repeat(frame, n - period - 1) &&
+                m_records[frame.items[n - period - 1]].period == period &&
+                same_items(frame, n - 2 * period - 1, n - period, period)) {
+                fold(frame, n - 2 * period - 1, n - period);
+                m_records[frame.items.back()].value++;
+                break;
+            }
+
+            /* A new repeat */
+            if (n >= 2 * period &&
+                same_items(frame, n - 2 * period, n - period, period)) {
+                fold(frame, n - 2 * period, n - period);
+                frame.items.push_back(m_records.size());
+                m_records.push_back(record_type{ log_kind_t::repeat, static_cast<uint32_t>(period), LabelType{}, 1U });
+                break;
+            }
+        }
+
+        if (frame.items.size() > 2 * MaxPeriod + 1) {
+            frame.items.erase(frame.items.begin());
+        }
+    }
+
+    /** Returns the end of the completed top level scopes */
+    size_t top_level_end() const {
+        return m_frames.size() > 1 ? m_frames[1].begin : m_records.size();
+    }
+
+    /** Returns the end of the scope whose begin record is at @i */
+    size_t scope_end(size_t i) const {
+        size_t depth { 0U };
+        for (; ; i++) {
+            if (m_records[i].kind == log_kind_t::begin) {
+                depth++;
+            } else if (m_records[i].kind == log_kind_t::end && --depth == 0) {
+                return i + 1;
+            }
+        }
+    }
+
+    /** @brief Splits the records from @begin to @end into the items of one
+     *         level, returns their ranges
+     */
+    std::vector<std::pair<size_t, size_t>> level_items(size_t begin, size_t end) const {
+        std::vector<std::pair<size_t, size_t>> items;
+        for (size_t i { begin }; i < end; ) {
+            size_t next = m_records[i].kind == log_kind_t::repeat ? i + 1 : scope_end(i);
+            items.emplace_back(i, next);
+            i = next;
+        }
+        return items;
+    }
+
+    /** Returns the number of events of the records from @begin to @end */
+    uint64_t count_events(size_t begin, size_t end) const {
+        auto items = level_items(begin, end);
+        std::vector<uint64_t> counts(items.size());
+        uint64_t result { 0U };
+        for (size_t i { 0U }; i < items.size(); i++) {
+            const record_type& r = m_records[items[i].first];
+            if (r.kind == log_kind_t::repeat) {
+                for (size_t j { i - r.period }; j < i; j++) {
+                    counts[i] += counts[j] * r.value;
+                }
+            } else {
+                counts[i] = 2 + count_events(items[i].first + 1, items[i].second - 1);
+            }
+            result += counts[i];
+        }
+        return result;
+    }
+
+    /** @brief Visits the events of the records from @begin to @end, at
+     *         @depth, where each scope stands for @iterations iterations
+     */
+    void expand(size_t begin, size_t end, size_t depth, uint64_t iterations, const std::function<void(const log_event_t<LabelType>& event)>& visitor) const {
+        auto items = level_items(begin, end);
+
+        /* The items covered by a repeat stand for more iterations. Repeats
+         * only cover items after the start of the enclosing repeat's items,
+         * so going backwards the iterations of the enclosing repeat are known.
+         */
+        std::vector<uint64_t> item_iterations(items.size(), iterations);
+        for (size_t i { items.size() }; i > 0; i--) {
+            const record_type& r = m_records[items[i - 1].first];
+            if (r.kind == log_kind_t::repeat) {
+                for (size_t j { i - 1 - r.period }; j < i - 1; j++) {
+                    item_iterations[j] = item_iterations[i - 1] * (r.value + 1);
+                }
+            }
+        }
+
+        for (size_t i { 0U }; i < items.size(); i++) {
+            expand_item(items, item_iterations, i, depth, visitor);
+        }
+    }
+
+    /** Visits the events of the item @i of a level */
+    void expand_item(const std::vector<std::pair<size_t, size_t>>& items, const std::vector<uint64_t>& item_iterations,
+                     size_t i, size_t depth, const std::function<void(const log_event_t<LabelType>& event)>& visitor) const {
+        const record_type& r = m_records[items[i].first];
+        if (r.kind == log_kind_t::repeat) {
+            for (uint64_t k { 0U }; k < r.value; k++) {
+                for (size_t j { i - r.period }; j < i; j++) {
+                    expand_item(items, item_iterations, j, depth, visitor);
+                }
+            }
+            return;
+        }
+
+        LabelType label = m_label_helper.restore(r.label);
+        visitor(log_event_t<LabelType>{ log_kind_t::begin, label, depth, 0U, item_iterations[i] });
+        expand(items[i].first + 1, items[i].second - 1, depth + 1, item_iterations[i], visitor);
+        visitor(log_event_t<LabelType>{ log_kind_t::end, label, depth, m_records[items[i].second - 1].value, item_iterations[i] });
+    }
+};
+
+/** @brief RAII wrapper logging a scope into event_log_t */
+template <typename LabelType, size_t MaxPeriod = 4>
+class log_scope_t {
+public:
+    log_scope_t(const LabelType& label, event_log_t<LabelType, MaxPeriod> * log) :
+        m_log(log)
+    {
+        m_log->begin(label);
+    }
+
+    ~log_scope_t() {
+        m_log->end();
+    }
+private:
+    event_log_t<LabelType, MaxPeriod> * m_log;
+};
+
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <cstdint>
+#include <ostream>
+#include <utility>
+#include <algorithm>
+#include <functional>
+#include "fiya-recorder.h"
+
+namespace fiya {
+
+/** Struct containing interesting information
+ *  about thrown exceptions.
+ */
+struct exception_usage_t {
+    /** Number of exceptions thrown while the label was active. */
+    uint64_t throws;
+    /** Wall time from allocating the exception until it was caught,
+     *  i.e. the throw itself and stack unwinding.
+     */
+    std::chrono::steady_clock::duration unwind_time;
+
+    exception_usage_t() :
+        throws(0ULL),
+        unwind_time(0) {}
+
+    exception_usage_t operator+(const exception_usage_t& other) const {
+        exception_usage_t result;
+        result.throws = throws + other.throws;
+        result.unwind_time = unwind_time + other.unwind_time;
+        return result;
+    }
+};
+
+/** Outputs the number of thrown exceptions. */
+inline void exception_throws_out(std::ostream& os, const exception_usage_t& m) {
+    os << m.throws;
+}
+
+/** Outputs the unwind time in microseconds. */
+inline void exception_unwind_time_out(std::ostream& os, const exception_usage_t& m) {
+    os << std::chrono::duration_cast<std::chrono::microseconds>(m.unwind_time).count();
+}
+
+/** RAII wrapper for counting thrown exceptions. Bear in mind
+ *  that you need to link fiya-exception-overloads.cpp as well
+ *  for this code to actually count the exceptions.
+ */
+template<typename LabelType>
+class measure_exception_t {
+public:
+    /** This RAII wrapper requires a pointer to this recorder_type */
+    using recorder_type = recorder_t<LabelType, exception_usage_t>;
+
+    /** Constructor will open the scope for the label provided to it */
+    measure_exception_t(const LabelType& label, recorder_type* recorder) :
+        m_recorder(recorder)
+    {
+        m_recorder->begin_scope(label);
+    }
+
+    /** Destructor will close the scope for the currently active label. It
+     *  also runs when the scope is left because of an exception.
+     */
+    ~measure_exception_t() {
+        m_recorder->end_scope();
+    }
+private:
+    /** Pointer to the recorder. */
+    recorder_type * m_recorder;
+};
+
+/** @brief Writes the paths that threw the most exceptions, one per line,
+ *         in the format "throws unwind_us label;label;label".
+ *
+ *  @param recorder  Recorder holding the exception counts
+ *  @param os        Output stream where to write the result
+ *  @param l_out     Function used to output the label type to output stream
+ *  @param max_paths Maximum number of paths to write
+ */
+template<typename LabelType>
+void to_throw_report(
+    recorder_t<LabelType, exception_usage_t>& recorder,
+    std::ostream& os,
+    const std::function<void(std::ostream& os, const LabelType& l)> & l_out,
+    size_t max_paths = 10)
+{
+    /* Paths are printed right away, because restored labels
+     * are only valid while the recorder is not modified.
+     */
+    std::vector<std::pair<exception_usage_t, std::string>> paths;
+    recorder.for_each_path([&] (const std::vector<LabelType>& path, const exception_usage_t& value) {
+        if (value.throws == 0) {
+            return;
+        }
+
+        std::ostringstream path_os;
+        for (size_t i { 0U }; i < path.size(); i++) {
+            if (i > 0) {
+                path_os << ";";
+            }
+            l_out(path_os, path[i]);
+        }
+        paths.emplace_back(value, path_os.str());
+    });
+
+    std::sort(paths.begin(), paths.end(), [] (const std::pair<exception_usage_t, std::string>& a, const std::pair<exception_usage_t, std::string>& b) {
+        return a.first.throws > b.first.throws ||
+            (a.first.throws == b.first.throws && a.first.unwind_time > b.first.unwind_time);
+    });
+
+    size_t count = std::min(max_paths, paths.size());
+    for (size_t i { 0U }; i < count; i++) {
+        os << paths[i].first.throws << " ";
+        exception_unwind_time_out(os, paths[i].first);
+        os << " " << paths[i].second << "\n";
+    }
+}
+
+}
@@ -0,0 +1,73 @@
+#include <dlfcn.h>
+
+#include "fiya-exception-measure.h"
+
+/** You will need to define this function in your code. It must return a thread_local
+ *  object in multithreaded program; otherwise it can create race conditions.
+ */
+extern fiya::counter_interface_t<fiya::exception_usage_t> * get_exception_counter();
+
+/** Time when the exception in flight was allocated. This is the
+ *  first thing a throw expression does.
+ */
+static thread_local std::chrono::steady_clock::time_point throw_start;
+
+/** Value of the scope that was active at the throw. Nodes of the
+ *  recorder are never moved, so the pointer stays valid while the
+ *  scopes are closed during unwinding.
+ */
+static thread_local fiya::exception_usage_t * throw_value = nullptr;
+
+/** Looks up the next definition of a symbol, i.e. the one from the C++ runtime. */
+template <typename Function>
+static Function next_symbol(const char * name) {
+    return reinterpret_cast<Function>(dlsym(RTLD_NEXT, name));
+}
+
+extern "C" {
+
+/** The compiler declares these functions itself; the type_info argument is declared as void*. */
+void * __cxa_allocate_exception(size_t thrown_size) noexcept;
+void __cxa_throw(void * thrown_exception, void * tinfo, void (*dest)(void *)) __attribute__((noreturn));
+void * __cxa_begin_catch(void * exception_object) noexcept;
+
+/** Called at the start of every throw expression to allocate the exception object. */
+void * __cxa_allocate_exception(size_t thrown_size) noexcept {
+    using function_t = void * (*)(size_t);
+    static function_t real = next_symbol<function_t>("__cxa_allocate_exception");
+
+    throw_start = std::chrono::steady_clock::now();
+    return real(thrown_size);
+}
+
+/** Called by the throw expression to start unwinding. We count the
+ *  exception to the scope active at this moment.
+ */
+void __cxa_throw(void * thrown_exception, void * tinfo, void (*dest)(void *)) {
+    using function_t = void (*)(void *, void *, void (*)(void *));
+    static function_t real = next_symbol<function_t>("__cxa_throw");
+
+    throw_value = nullptr;
+    fiya::counter_interface_t<fiya::exception_usage_t> * counter = get_exception_counter();
+    if (counter && !counter->recorder_internal_running()) {
+        throw_value = &counter->cnt();
+        throw_value->throws += 1;
+    }
+
+    real(thrown_exception, tinfo, dest);
+    __builtin_unreachable();
+}
+
+/** Called when a catch handler is entered, which ends the unwinding. */
+void * __cxa_begin_catch(void * exception_object) noexcept {
+    using function_t = void * (*)(void *);
+    static function_t real = next_symbol<function_t>("__cxa_begin_catch");
+
+    if (throw_value) {
+        throw_value->unwind_time += std::chrono::steady_clock::now() - throw_start;
+        throw_value = nullptr;
+    }
+    return real(exception_object);
+}
+
+}
@@ -0,0 +1,312 @@
+#pragma once
+
+#include <mutex>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <ostream>
+#include <algorithm>
+#include <functional>
+#include <condition_variable>
+
+#include "fiya-time-measure.h"
+
+#ifdef FIYA_USE_POSIX_TIME
+#include <pthread.h>
+#endif
+
+namespace fiya {
+
+/** @brief Returns the timestamp of gauge samples, in nanoseconds of the
+ *         steady clock. The times of heatmap_recorder_t in fiya-heatmap.h
+ *         are relative to its origin_ns() on the same clock.
+ */
+inline uint64_t gauge_now_ns() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+/** A sample of a gauge */
+struct gauge_sample_t {
+    /** Time of the sample, see gauge_now_ns() */
+    uint64_t ns;
+    double value;
+};
+
+/** @brief Ring buffer of the last samples of a gauge, allocated once */
+class gauge_ring_t {
+public:
+    gauge_ring_t(size_t capacity) :
+        m_samples(new gauge_sample_t[std::max<size_t>(capacity, 1U)]),
+        m_capacity(std::max<size_t>(capacity, 1U)),
+        m_count(0U) {}
+
+    void push(const gauge_sample_t& sample) {
+        m_samples[m_count % m_capacity] = sample;
+        m_count++;
+    }
+
+    /** Returns the number of samples in the ring */
+    size_t size() const {
+        return std::min(m_count, m_capacity);
+    }
+
+    /** Returns the sample @i, 0 is the oldest in the ring */
+    const gauge_sample_t& operator[](size_t i) const {
+        size_t oldest = m_count > m_capacity ? m_count % m_capacity : 0U;
+        return m_samples[(oldest + i) % m_capacity];
+    }
+private:
+    std::unique_ptr<gauge_sample_t[]> m_samples;
+    size_t m_capacity;
+    /** Number of samples ever pushed */
+    size_t m_count;
+};
+
+/** @brief Gauges, e.g. queue depth, connection count or RSS, read by a
+ *         background sampler at a fixed rate into a ring buffer per gauge.
+ *         Threads can also be registered: the sampler reads their CPU time,
+ *         which gives the thread activity, as a fraction of the interval.
+ *
+ *  Gauge functions are called from the sampler thread, so they must be
+ *  thread-safe, e.g. read an atomic. All methods are thread-safe.
+ *  The samples are exported as counter tracks in the Chrome Trace Event
+ *  format, which Perfetto and chrome://tracing open.
+ */
+class gauge_sampler_t {
+public:
+    /** Constructor
+     *
+     *    @param period   Time between two samples
+     *    @param capacity Number of samples kept per gauge
+     */
+    gauge_sampler_t(std::chrono::nanoseconds period = std::chrono::milliseconds(100), size_t capacity = 4096) :
+        m_period(period),
+        m_capacity(capacity),
+        m_running(false) {}
+
+    ~gauge_sampler_t() {
+        stop();
+    }
+
+    gauge_sampler_t(const gauge_sampler_t&) = delete;
+    gauge_sampler_t& operator=(const gauge_sampler_t&) = delete;
+
+    /** Registers the gauge @name, read by calling @read */
+    void add_gauge(const std::string& name, std::function<double()> read) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_gauges.emplace_back(new gauge_t{ name, std::move(read), gauge_ring_t(m_capacity) });
+    }
+
+    /** @brief Registers the calling thread as @name: its CPU time is sampled
+     *         into a track of its activity. The thread must stay alive while
+     *         the sampler runs.
+     */
+    void add_current_thread(const std::string& name) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        thread_t * thread = new thread_t{ name, m_threads.size() + 1, {}, 0U, 0U, 0U, gauge_ring_t(m_capacity) };
+#ifdef FIYA_USE_POSIX_TIME
+        pthread_getcpuclockid(pthread_self(), &thread->clock);
+#elif defined(FIYA_USE_WINDOWS_TIME)
+        DuplicateHandle(GetCurrentProcess(), GetCurrentThread(), GetCurrentProcess(), &thread->clock,
+                        THREAD_QUERY_INFORMATION, FALSE, 0);
+#endif
+        m_threads.emplace_back(thread);
+    }
+
+    /** Starts the background sampler */
+    void start() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_running) {
+            return;
+        }
+        m_running = true;
+        m_thread = std::thread([this] { run(); });
+    }
+
+    /** Stops the background sampler and waits for it */
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_running) {
+                return;
+            }
+            m_running = false;
+        }
+        m_wakeup.notify_all();
+        m_thread.join();
+    }
+
+    /** Reads all gauges and threads now; called by the background sampler */
+    void sample_now() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        sample_locked();
+    }
+
+    /** @brief Writes the samples as counter tracks in the Chrome Trace Event
+     *         JSON format: one track per gauge, and per thread a track of the
+     *         CPU utilization in percent, with the total CPU time and
+     *         the average utilization in the thread's metadata.
+     *
+     *  @param origin_ns Time written as 0, see gauge_now_ns(); samples before
+     *                   it are left out. Pass heatmap_recorder_t::origin_ns()
+     *                   to get the times of its heatmap and range flamegraphs.
+     */
+    void to_chrome_trace(std::ostream& os, uint64_t origin_ns = 0U) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const char * separator = "";
+        /* Large gauges, e.g. RSS in bytes, need more than the default 6 digits */
+        std::streamsize precision = os.precision(15);
+        os << "{\"traceEvents\":[\n";
+
+        for (const auto& gauge : m_gauges) {
+            for (size_t i { 0U }; i < gauge->samples.size(); i++) {
+                if (gauge->samples[i].ns >= origin_ns) {
+                    os << separator;
+                    counter_event_out(os, gauge->name, 0U, gauge->samples[i], origin_ns, "value");
+                    separator = ",\n";
+                }
+            }
+        }
+
+        for (const auto& thread : m_threads) {
+            double utilization = 0.0;
+            uint64_t wall_ns = thread->last_ns - thread->first_ns;
+            if (wall_ns > 0) {
+                utilization = 100.0 * thread->total_cpu_ns / wall_ns;
+            }
+
+            os << separator << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << thread->tid <<
+                ",\"args\":{\"name\":";
+            string_out(os, thread->name);
+            os << ",\"cpu_ms\":" << thread->total_cpu_ns / 1000000.0 << ",\"utilization\":" << utilization << "}}";
+            separator = ",\n";
+
+            for (size_t i { 0U }; i < thread->samples.size(); i++) {
+                if (thread->samples[i].ns >= origin_ns) {
+                    os << separator;
+                    counter_event_out(os, "CPU " + thread->name, thread->tid, thread->samples[i], origin_ns, "cpu %");
+                }
+            }
+        }
+        os << "\n]}\n";
+        os.precision(precision);
+    }
+private:
+    struct gauge_t {
+        std::string name;
+        std::function<double()> read;
+        gauge_ring_t samples;
+    };
+
+    struct thread_t {
+        std::string name;
+        /** Thread id in the trace */
+        size_t tid;
+#ifdef FIYA_USE_POSIX_TIME
+        clockid_t clock;
+#elif defined(FIYA_USE_WINDOWS_TIME)
+        HANDLE clock;
+#endif
+        /** Time and CPU time of the first and of the last sample */
+        uint64_t first_ns;
+        uint64_t last_ns;
+        uint64_t last_cpu_ns;
+        /** CPU utilization in percent in each interval */
+        gauge_ring_t samples;
+        /** CPU time since the first sample */
+        uint64_t total_cpu_ns = 0;
+    };
+
+    std::chrono::nanoseconds m_period;
+    size_t m_capacity;
+    std::vector<std::unique_ptr<gauge_t>> m_gauges;
+    std::vector<std::unique_ptr<thread_t>> m_threads;
+
+    /** Protects all of the above and m_running */
+    std::mutex m_mutex;
+    std::condition_variable m_wakeup;
+    bool m_running;
+    std::thread m_thread;
+
+    void run() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto next = std::chrono::steady_clock::now();
+        while (m_running) {
+            sample_locked();
+            next += m_period;
+            m_wakeup.wait_until(lock, next, [this] { return !m_running; });
+        }
+    }
+
+    void sample_locked() {
+        for (auto& gauge : m_gauges) {
+            gauge->samples.push(gauge_sample_t{ gauge_now_ns(), gauge->read() });
+        }
+
+        for (auto& thread : m_threads) {
+            uint64_t now_ns = gauge_now_ns();
+            uint64_t cpu_ns = thread_cpu_ns(*thread);
+            if (thread->first_ns == 0) {
+                thread->first_ns = now_ns;
+            } else if (now_ns > thread->last_ns) {
+                uint64_t used_ns = cpu_ns - std::min(cpu_ns, thread->last_cpu_ns);
+                thread->total_cpu_ns += used_ns;
+                thread->samples.push(gauge_sample_t{ now_ns, 100.0 * used_ns / (now_ns - thread->last_ns) });
+            }
+            thread->last_ns = now_ns;
+            thread->last_cpu_ns = cpu_ns;
+        }
+    }
+
+    static uint64_t thread_cpu_ns(const thread_t& thread) {
+#ifdef FIYA_USE_POSIX_TIME
+        struct timespec ts;
+        if (clock_gettime(thread.clock, &ts) == 0) {
+            return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + static_cast<uint64_t>(ts.tv_nsec);
+        }
+#elif defined(FIYA_USE_WINDOWS_TIME)
+        FILETIME creationTime, exitTime, kernelTime, userTime;
+        if (GetThreadTimes(thread.clock, &creationTime, &exitTime, &kernelTime, &userTime)) {
+            ULARGE_INTEGER kt, ut;
+            kt.LowPart = kernelTime.dwLowDateTime;
+            kt.HighPart = kernelTime.dwHighDateTime;
+            ut.LowPart = userTime.dwLowDateTime;
+            ut.HighPart = userTime.dwHighDateTime;
+            /* Units of 100 ns */
+            return (kt.QuadPart + ut.QuadPart) * 100U;
+        }
+#endif
+        return 0U;
+    }
+
+    /** Writes @s as a JSON string */
+    static void string_out(std::ostream& os, const std::string& s) {
+        os << '"';
+        for (char c : s) {
+            if (c == '"' || c == '\\') {
+                os << '\\' << c;
+            } else if (static_cast<unsigned char>(c) < 0x20) {
+                os << ' ';
+            } else {
+                os << c;
+            }
+        }
+        os << '"';
+    }
+
+    /** Writes a counter event, the timestamp in microseconds since @origin_ns */
+    static void counter_event_out(std::ostream& os, const std::string& name, size_t tid, const gauge_sample_t& sample,
+                                  uint64_t origin_ns, const char * key) {
+        uint64_t ns = sample.ns - origin_ns;
+        os << "{\"name\":";
+        string_out(os, name);
+        os << ",\"ph\":\"C\",\"ts\":" << ns / 1000 << "." << (ns % 1000) / 100 <<
+            ",\"pid\":0,\"tid\":" << tid << ",\"args\":{\"" << key << "\":" << sample.value << "}}";
+    }
+};
+
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <chrono>
+#include "fiya-level.h"
 #include "fiya-recorder.h"
 
 namespace fiya {
@@ -36,26 +37,38 @@ struct heap_usage_t {
 /** RAII wrapper for measuring heap consumption. Bear in mind
  *  that you need to link fiya-heap-overloads.cpp as well
  *  for this code to actually measure memory consumptions.
+ *  The RecorderType can be any type with recorder_t's begin_scope
+ *  and end_scope, e.g. window_recorder_t from fiya-window.h.
  */
-template<typename LabelType>
+template<typename LabelType, typename RecorderType = recorder_t<LabelType, heap_usage_t>>
 class measure_heap_t {
 public:
     /** This RAII wrapper requires a pointer to this recorder_type */
-    using recorder_type = recorder_t<LabelType, heap_usage_t>;
+    using recorder_type = RecorderType;
 
-    /** Constructor will open the scope for the label provided to it */
-    measure_heap_t(const LabelType& label, recorder_type* recorder) :
-        m_recorder(recorder)
+    /** Constructor will open the scope for the label provided to it, unless
+     *  recording is disabled or @level is finer than the active level
+     *  (see fiya-level.h). Allocations of a skipped scope are accounted to
+     *  the enclosing scope.
+     */
+    measure_heap_t(const LabelType& label, recorder_type* recorder, level_t level = level_t::normal) :
+        m_recorder(is_level_active(level) ? recorder : nullptr)
     {
-        m_recorder->begin_scope(label);
+        if (m_recorder) {
+            m_recorder->begin_scope(label);
+        }
     }
 
-    /** Destructor will close the scope for the currently active label. */
+    /** Destructor will close the scope for the currently active label,
+     *  if the constructor opened it.
+     */
     ~measure_heap_t() {
-        m_recorder->end_scope();
+        if (m_recorder) {
+            m_recorder->end_scope();
+        }
     }
 private:
-    /** Pointer to the recorder. */
+    /** Pointer to the recorder, nullptr if the scope is not recorded. */
     recorder_type * m_recorder;
 };
 
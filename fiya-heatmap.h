@@ -0,0 +1,427 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <ostream>
+#include <algorithm>
+#include <functional>
+
+#include "fiya-time-measure.h"
+
+namespace fiya {
+
+namespace detail {
+
+/** Returns @amount * @part / @whole without overflowing the product */
+inline uint64_t proportion(uint64_t amount, uint64_t part, uint64_t whole) {
+    return static_cast<uint64_t>(static_cast<unsigned __int128>(amount) * part / whole);
+}
+
+}
+
+/** @brief Grid of CPU time bucketed by wall clock time, as in FlameScope:
+ *         each column is a column_length (by default one second) long slice
+ *         of time, each row a 1/Rows part of it, so periodic activity shows
+ *         as a horizontal pattern.
+ *
+ *  The grid is a ring of the last Columns columns in fixed size arrays.
+ *  Times are in nanoseconds since the heatmap was created.
+ */
+template <size_t Columns, size_t Rows>
+class heatmap_t {
+public:
+    heatmap_t(std::chrono::nanoseconds column_length = std::chrono::seconds(1)) :
+        m_column_ns(static_cast<uint64_t>(column_length.count())),
+        m_cell_ns(std::max<uint64_t>(m_column_ns / Rows, 1U)),
+        m_cells{},
+        m_column_ids{},
+        m_latest_column(0U)
+    {
+        std::fill(std::begin(m_column_ids), std::end(m_column_ids), UINT64_MAX);
+    }
+
+    /** @brief Adds @amount_ns to the cells covering the wall clock time from
+     *         @start_ns to @end_ns, in proportion to the overlap.
+     */
+    void add(uint64_t start_ns, uint64_t end_ns, uint64_t amount_ns) {
+        if (end_ns <= start_ns) {
+            cell(start_ns) += amount_ns;
+            return;
+        }
+
+        /* Only the part inside the ring is kept */
+        uint64_t span_ns = end_ns - start_ns;
+        uint64_t first_ns = end_ns - std::min<uint64_t>(span_ns, m_column_ns * Columns);
+        for (uint64_t t { first_ns }; t < end_ns; ) {
+            uint64_t cell_end = std::min(end_ns, (t / m_cell_ns + 1) * m_cell_ns);
+            cell(t) += detail::proportion(amount_ns, cell_end - t, span_ns);
+            t = cell_end;
+        }
+    }
+
+    /** Returns the length of a column in nanoseconds */
+    uint64_t column_ns() const {
+        return m_column_ns;
+    }
+
+    /** @brief Calls @visitor for each cell of the columns in the ring, oldest
+     *         first, with the column number (the second since the start),
+     *         the row and the value in nanoseconds.
+     */
+    void for_each_cell(const std::function<void(uint64_t column, size_t row, uint64_t value_ns)>& visitor) const {
+        uint64_t first = m_latest_column + 1 >= Columns ? m_latest_column + 1 - Columns : 0U;
+        for (uint64_t column { first }; column <= m_latest_column; column++) {
+            size_t slot = column % Columns;
+            for (size_t row { 0U }; row < Rows; row++) {
+                visitor(column, row, m_column_ids[slot] == column ? m_cells[slot][row] : 0U);
+            }
+        }
+    }
+
+    /** @brief Writes the heatmap as an SVG image: columns from left to right,
+     *         rows (offsets in the column) from top to bottom, darker cells have
+     *         more CPU time. Hovering a cell shows its time range, to select
+     *         the range of a flamegraph.
+     */
+    void to_svg(std::ostream& os, const char * title = "FIYA heatmap") const {
+        const size_t cell_width = 12;
+        const size_t cell_height = 8;
+        const size_t margin = 40;
+
+        uint64_t max_ns = 1;
+        for_each_cell([&max_ns] (uint64_t, size_t, uint64_t value_ns) {
+            max_ns = std::max(max_ns, value_ns);
+        });
+
+        size_t width = Columns * cell_width + 2 * margin;
+        size_t height = Rows * cell_height + 2 * margin;
+        os << "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"" << width << "\" height=\"" << height << "\">\n";
+        os << "<text x=\"" << margin << "\" y=\"" << margin / 2 << "\" font-family=\"sans-serif\" font-size=\"14\">" <<
+            title << "</text>\n";
+
+        uint64_t first = m_latest_column + 1 >= Columns ? m_latest_column + 1 - Columns : 0U;
+        for_each_cell([&] (uint64_t column, size_t row, uint64_t value_ns) {
+            size_t x = margin + static_cast<size_t>(column - first) * cell_width;
+            size_t y = margin + row * cell_height;
+            /* From white to dark red, like FlameScope */
+            double intensity = static_cast<double>(value_ns) / max_ns;
+            int green_blue = static_cast<int>(255 * (1.0 - intensity));
+            int red = static_cast<int>(255 - 100 * intensity);
+
+            uint64_t start_ns = column * m_column_ns + row * m_cell_ns;
+            os << "<rect x=\"" << x << "\" y=\"" << y << "\" width=\"" << cell_width << "\" height=\"" << cell_height <<
+                "\" fill=\"rgb(" << red << "," << green_blue << "," << green_blue << ")\">" <<
+                "<title>" << start_ns / 1000000 << "-" << (start_ns + m_cell_ns) / 1000000 << " ms: " <<
+                value_ns / 1000 << " us</title></rect>\n";
+
+            if (row == 0 && column % 10 == 0) {
+                os << "<text x=\"" << x << "\" y=\"" << margin + Rows * cell_height + 14 <<
+                    "\" font-family=\"sans-serif\" font-size=\"10\">" << column << "</text>\n";
+            }
+        });
+        os << "</svg>\n";
+    }
+private:
+    /** Length of a column and of a cell */
+    uint64_t m_column_ns;
+    uint64_t m_cell_ns;
+    /** CPU time of each cell, in nanoseconds */
+    uint64_t m_cells[Columns][Rows];
+    /** Column number stored in each slot of the ring */
+    uint64_t m_column_ids[Columns];
+    /** Newest column number */
+    uint64_t m_latest_column;
+
+    /** Returns the cell of the time @t_ns, clearing reused columns */
+    uint64_t& cell(uint64_t t_ns) {
+        uint64_t column = t_ns / m_column_ns;
+        size_t slot = column % Columns;
+        if (m_column_ids[slot] != column) {
+            std::fill(std::begin(m_cells[slot]), std::end(m_cells[slot]), 0U);
+            m_column_ids[slot] = column;
+        }
+        m_latest_column = std::max(m_latest_column, column);
+        return m_cells[slot][std::min<size_t>((t_ns % m_column_ns) / m_cell_ns, Rows - 1)];
+    }
+};
+
+/** @brief Recorder of scope activity by wall clock time. Keeps in fixed size
+ *         storage allocated at construction:
+ *   - the call tree of at most MaxNodes nodes with the cumulative CPU time,
+ *   - the heatmap of the whole thread and the heatmap of a selected label,
+ *     counting the CPU time while the label is on the stack,
+ *   - a ring of the last Events scope transitions, each with its wall
+ *     clock interval, node and CPU time, used for the flamegraph of any
+ *     time range the ring still covers.
+ *
+ *  It reads the clocks itself on each transition; use it with
+ *  measure_heatmap_t. Like recorder_t, use one per thread.
+ */
+template <typename LabelType, size_t Columns = 60, size_t Rows = 50, size_t MaxNodes = 4096, size_t Events = 65536>
+class heatmap_recorder_t: public scoping_interface_t<LabelType> {
+public:
+    using label_type = LabelType;
+    using heatmap_type = heatmap_t<Columns, Rows>;
+
+    /** Constructor
+     *
+     *    @param root_label    Label of the root
+     *    @param column_length Length of a heatmap column
+     */
+    heatmap_recorder_t(const LabelType& root_label, std::chrono::nanoseconds column_length = std::chrono::seconds(1)) :
+        m_nodes(new node_t[MaxNodes]),
+        m_size(1U),
+        m_current(0U),
+        m_overflow_depth(0U),
+        m_thread_heatmap(column_length),
+        m_label_heatmap(column_length),
+        m_has_selected(false),
+        m_selected_depth(0U),
+        m_events(new event_t[Events]),
+        m_event_count(0U),
+        m_start(std::chrono::steady_clock::now()),
+        m_last_wall_ns(0U),
+        m_last_cpu(get_thread_time<void>())
+    {
+        m_nodes[0].label = m_label_helper.save(root_label);
+    }
+
+    /** @brief Selects the label whose activity is recorded in label_heatmap().
+     *         Takes effect for the scopes opened from now on.
+     */
+    void select_label(const LabelType& label) {
+        m_selected = label;
+        m_has_selected = true;
+        m_selected_depth = 0U;
+    }
+
+    void begin_scope(const LabelType& label) override {
+        transition();
+        if (m_overflow_depth > 0 || !enter(label)) {
+            m_overflow_depth++;
+        }
+    }
+
+    void end_scope() override {
+        transition();
+        if (m_overflow_depth > 0) {
+            m_overflow_depth--;
+        } else if (m_current != 0) {
+            if (is_selected(m_nodes[m_current].label) && m_selected_depth > 0) {
+                m_selected_depth--;
+            }
+            m_current = m_nodes[m_current].parent;
+        }
+    }
+
+    void end_scope(const LabelType&) override {
+        end_scope();
+    }
+
+    bool recorder_internal_running() const override {
+        return false;
+    }
+
+    /** Returns the heatmap of the whole thread */
+    const heatmap_type& thread_heatmap() const {
+        return m_thread_heatmap;
+    }
+
+    /** Returns the heatmap of the selected label */
+    const heatmap_type& label_heatmap() const {
+        return m_label_heatmap;
+    }
+
+    /** @brief Returns the start of the recorder in nanoseconds of the steady
+     *         clock, as gauge_now_ns() in fiya-gauges.h. The times of the
+     *         heatmap and of the ranges are relative to it.
+     */
+    uint64_t origin_ns() const {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            m_start.time_since_epoch()).count());
+    }
+
+    /** @brief Returns the time (in nanoseconds since the start, as in the heatmap)
+     *         of the oldest transition in the ring. Flamegraphs of ranges
+     *         before it are incomplete.
+     */
+    uint64_t events_begin_ns() const {
+        if (m_event_count == 0) {
+            return m_last_wall_ns;
+        }
+        size_t oldest = m_event_count > Events ? m_event_count % Events : 0U;
+        return m_events[oldest].start_ns;
+    }
+
+    /** @brief Writes the cumulative flamegraph in the collapsed stack format,
+     *         with the CPU time in microseconds.
+     */
+    void to_collapsed_stacks(std::ostream& os, const std::function<void(std::ostream& os, const LabelType& l)> & l_out) {
+        std::vector<uint64_t> ns(m_size);
+        for (uint32_t node { 0U }; node < m_size; node++) {
+            ns[node] = m_nodes[node].ns;
+        }
+        write_stacks(os, l_out, ns);
+    }
+
+    /** @brief Writes the flamegraph of the wall clock range [@from_ns, @to_ns),
+     *         in nanoseconds since the start as in the heatmap, in the collapsed
+     *         stack format with the CPU time in microseconds. Only the range
+     *         covered by the ring of transitions is included.
+     */
+    void to_range_collapsed_stacks(
+        std::ostream& os,
+        const std::function<void(std::ostream& os, const LabelType& l)> & l_out,
+        uint64_t from_ns,
+        uint64_t to_ns)
+    {
+        std::vector<uint64_t> ns(m_size);
+        size_t count = std::min(m_event_count, Events);
+        for (size_t i { 0U }; i < count; i++) {
+            const event_t& e = m_events[i];
+            uint64_t start = std::max(e.start_ns, from_ns);
+            uint64_t end = std::min(e.end_ns, to_ns);
+            if (e.end_ns == e.start_ns && e.start_ns >= from_ns && e.start_ns < to_ns) {
+                ns[e.node] += e.cpu_ns;
+            } else if (start < end) {
+                ns[e.node] += detail::proportion(e.cpu_ns, end - start, e.end_ns - e.start_ns);
+            }
+        }
+        write_stacks(os, l_out, ns);
+    }
+private:
+    struct node_t {
+        LabelType label;
+        uint32_t parent = 0;
+        uint32_t first_child = 0;
+        uint32_t next_sibling = 0;
+        /** Cumulative CPU time in nanoseconds */
+        uint64_t ns = 0;
+    };
+
+    /** CPU time spent in a node during a wall clock interval */
+    struct event_t {
+        uint64_t start_ns;
+        uint64_t end_ns;
+        uint64_t cpu_ns;
+        uint32_t node;
+    };
+
+    label_helper<LabelType> m_label_helper;
+    std::unique_ptr<node_t[]> m_nodes;
+    uint32_t m_size;
+    uint32_t m_current;
+    /** Depth of the scopes opened after the tree was full */
+    uint64_t m_overflow_depth;
+
+    heatmap_type m_thread_heatmap;
+    heatmap_type m_label_heatmap;
+    /** Selected label, in the external representation */
+    LabelType m_selected {};
+    bool m_has_selected;
+    /** Number of open scopes with the selected label */
+    uint32_t m_selected_depth;
+
+    /** Ring of the last transitions */
+    std::unique_ptr<event_t[]> m_events;
+    size_t m_event_count;
+
+    /** Start of the wall clock time */
+    std::chrono::steady_clock::time_point m_start;
+    /** Wall clock and CPU time of the last transition */
+    uint64_t m_last_wall_ns;
+    std::chrono::time_point<std::chrono::high_resolution_clock> m_last_cpu;
+
+    bool is_selected(const LabelType& internal_label) const {
+        return m_has_selected && m_label_helper.equal(internal_label, m_selected);
+    }
+
+    /** Accounts the CPU time since the last transition to the current node */
+    void transition() {
+        uint64_t wall_ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - m_start).count());
+        auto cpu = get_thread_time<void>();
+        uint64_t cpu_ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(cpu - m_last_cpu).count());
+
+        m_nodes[m_current].ns += cpu_ns;
+        m_thread_heatmap.add(m_last_wall_ns, wall_ns, cpu_ns);
+        if (m_selected_depth > 0) {
+            m_label_heatmap.add(m_last_wall_ns, wall_ns, cpu_ns);
+        }
+        m_events[m_event_count % Events] = event_t{ m_last_wall_ns, wall_ns, cpu_ns, m_current };
+        m_event_count++;
+
+        m_last_wall_ns = wall_ns;
+        m_last_cpu = cpu;
+    }
+
+    /** Enters the child with @label, returns false if the tree is full */
+    bool enter(const LabelType& label) {
+        uint32_t child { m_nodes[m_current].first_child };
+        while (child != 0 && !m_label_helper.equal(m_nodes[child].label, label)) {
+            child = m_nodes[child].next_sibling;
+        }
+
+        if (child == 0) {
+            if (m_size == MaxNodes) {
+                return false;
+            }
+            child = m_size++;
+            m_nodes[child].label = m_label_helper.save(label);
+            m_nodes[child].parent = m_current;
+            m_nodes[child].next_sibling = m_nodes[m_current].first_child;
+            m_nodes[m_current].first_child = child;
+        }
+
+        m_current = child;
+        if (is_selected(m_nodes[child].label)) {
+            m_selected_depth++;
+        }
+        return true;
+    }
+
+    /** Writes the nodes with non-zero time in @ns as collapsed stacks */
+    void write_stacks(std::ostream& os, const std::function<void(std::ostream& os, const LabelType& l)> & l_out, const std::vector<uint64_t>& ns) {
+        std::vector<uint32_t> path;
+        for (uint32_t node { 0U }; node < m_size; node++) {
+            if (ns[node] == 0) {
+                continue;
+            }
+            path.clear();
+            for (uint32_t n { node }; ; n = m_nodes[n].parent) {
+                path.push_back(n);
+                if (n == 0) {
+                    break;
+                }
+            }
+            for (size_t i { path.size() }; i > 0; i--) {
+                l_out(os, m_label_helper.restore(m_nodes[path[i - 1]].label));
+                os << (i > 1 ? ";" : "");
+            }
+            os << " " << (ns[node] + 500) / 1000 << "\n";
+        }
+    }
+};
+
+/** @brief RAII wrapper opening a scope in heatmap_recorder_t, which reads
+ *         the clocks itself.
+ */
+template <typename RecorderType>
+class measure_heatmap_t {
+public:
+    measure_heatmap_t(const typename RecorderType::label_type& label, RecorderType * recorder) :
+        m_recorder(recorder)
+    {
+        m_recorder->begin_scope(label);
+    }
+
+    ~measure_heatmap_t() {
+        m_recorder->end_scope();
+    }
+private:
+    RecorderType * m_recorder;
+};
+
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include "fiya-recorder.h"
+
+namespace fiya {
+
+/** Struct containing interesting information
+ *  about file and socket I/O.
+ */
+struct io_usage_t {
+    /** Bytes returned by read, pread, readv, recv, recvfrom and recvmsg. */
+    uint64_t bytes_read;
+    /** Bytes accepted by write, pwrite, writev, send, sendto and sendmsg. */
+    uint64_t bytes_written;
+    /** Number of I/O calls, including fsync and fdatasync. */
+    uint64_t calls;
+    /** Wall time spent blocked in the I/O calls. */
+    std::chrono::steady_clock::duration wait;
+
+    io_usage_t() :
+        bytes_read(0ULL),
+        bytes_written(0ULL),
+        calls(0ULL),
+        wait(0) {}
+
+    io_usage_t operator+(const io_usage_t& other) const {
+        io_usage_t result;
+        result.bytes_read = bytes_read + other.bytes_read;
+        result.bytes_written = bytes_written + other.bytes_written;
+        result.calls = calls + other.calls;
+        result.wait = wait + other.wait;
+        return result;
+    }
+};
+
+/** Outputs the number of bytes read and written. Pass it
+ *  to recorder_t::to_collapsed_stacks to get the "I/O bytes" flamegraph.
+ */
+inline void io_bytes_out(std::ostream& os, const io_usage_t& m) {
+    os << m.bytes_read + m.bytes_written;
+}
+
+/** Outputs the time blocked in I/O in microseconds. Pass it
+ *  to recorder_t::to_collapsed_stacks to get the "I/O wait" flamegraph.
+ */
+inline void io_wait_out(std::ostream& os, const io_usage_t& m) {
+    os << std::chrono::duration_cast<std::chrono::microseconds>(m.wait).count();
+}
+
+/** RAII wrapper for measuring I/O. Bear in mind
+ *  that you need to link fiya-io-overloads.cpp as well (or
+ *  preload it as a shared library) for this code to actually
+ *  measure the I/O. Other calls, e.g. sendfile, splice, mmap'd
+ *  files or io_uring, are not measured.
+ */
+template<typename LabelType>
+class measure_io_t {
+public:
+    /** This RAII wrapper requires a pointer to this recorder_type */
+    using recorder_type = recorder_t<LabelType, io_usage_t>;
+
+    /** Constructor will open the scope for the label provided to it */
+    measure_io_t(const LabelType& label, recorder_type* recorder) :
+        m_recorder(recorder)
+    {
+        m_recorder->begin_scope(label);
+    }
+
+    /** Destructor will close the scope for the currently active label. */
+    ~measure_io_t() {
+        m_recorder->end_scope();
+    }
+private:
+    /** Pointer to the recorder. */
+    recorder_type * m_recorder;
+};
+
+}
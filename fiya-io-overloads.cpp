@@ -0,0 +1,158 @@
+#include <cerrno>
+#include <dlfcn.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#include "fiya-io-measure.h"
+
+/** You will need to define this function in your code. It must return a thread_local
+ *  object in multithreaded program; otherwise it can create race conditions.
+ *
+ *  @note The symbol is weak so this file can also be built as a shared
+ *        library and loaded with LD_PRELOAD. In that case, link your
+ *        program with -rdynamic so the library can find the function.
+ */
+extern fiya::counter_interface_t<fiya::io_usage_t> * get_io_counter() __attribute__((weak));
+
+/** Set while we are measuring an I/O call. This is because we want to avoid
+ *  recursive measurements, e.g. if the recorder itself does I/O.
+ */
+static thread_local bool io_profiling_ongoing = false;
+
+/** Kind of I/O call, decides which member of io_usage_t gets the bytes. */
+enum class io_kind_e {
+    read,
+    write,
+    sync
+};
+
+/** Looks up the next definition of a symbol, i.e. the one from the C library. */
+template <typename Function>
+static Function next_symbol(Function, const char * name) {
+    return reinterpret_cast<Function>(dlsym(RTLD_NEXT, name));
+}
+
+/** Calls the real I/O function and charges its bytes and latency
+ *  to the current scope of the thread's recorder. The caller sees
+ *  the errno set by the real function.
+ */
+template <typename Function, typename... Args>
+static auto measure_io_call(io_kind_e kind, Function real, Args... args) -> decltype(real(args...)) {
+    if (io_profiling_ongoing || get_io_counter == nullptr) {
+        return real(args...);
+    }
+
+    io_profiling_ongoing = true;
+    std::chrono::steady_clock::time_point start { std::chrono::steady_clock::now() };
+    auto result = real(args...);
+    int saved_errno = errno;
+    std::chrono::steady_clock::time_point end { std::chrono::steady_clock::now() };
+
+    fiya::counter_interface_t<fiya::io_usage_t> * counter = get_io_counter();
+    if (counter && !counter->recorder_internal_running()) {
+        fiya::io_usage_t & io = counter->cnt();
+
+        io.calls += 1;
+        io.wait += end - start;
+        if (result > 0) {
+            if (kind == io_kind_e::read) {
+                io.bytes_read += static_cast<uint64_t>(result);
+            } else if (kind == io_kind_e::write) {
+                io.bytes_written += static_cast<uint64_t>(result);
+            }
+        }
+    }
+    io_profiling_ongoing = false;
+
+    errno = saved_errno;
+    return result;
+}
+
+extern "C" {
+
+ssize_t read(int fd, void * buf, size_t count) {
+    static auto real = next_symbol(&read, "read");
+    return measure_io_call(io_kind_e::read, real, fd, buf, count);
+}
+
+ssize_t write(int fd, const void * buf, size_t count) {
+    static auto real = next_symbol(&write, "write");
+    return measure_io_call(io_kind_e::write, real, fd, buf, count);
+}
+
+ssize_t pread(int fd, void * buf, size_t count, off_t offset) {
+    static auto real = next_symbol(&pread, "pread");
+    return measure_io_call(io_kind_e::read, real, fd, buf, count, offset);
+}
+
+ssize_t pwrite(int fd, const void * buf, size_t count, off_t offset) {
+    static auto real = next_symbol(&pwrite, "pwrite");
+    return measure_io_call(io_kind_e::write, real, fd, buf, count, offset);
+}
+
+#if defined(__GLIBC__) && !defined(__USE_FILE_OFFSET64)
+/** Programs built with _FILE_OFFSET_BITS=64 call these instead of pread and pwrite. */
+ssize_t pread64(int fd, void * buf, size_t count, off64_t offset) {
+    static auto real = next_symbol(&pread64, "pread64");
+    return measure_io_call(io_kind_e::read, real, fd, buf, count, offset);
+}
+
+ssize_t pwrite64(int fd, const void * buf, size_t count, off64_t offset) {
+    static auto real = next_symbol(&pwrite64, "pwrite64");
+    return measure_io_call(io_kind_e::write, real, fd, buf, count, offset);
+}
+#endif
+
+ssize_t readv(int fd, const struct iovec * iov, int iovcnt) {
+    static auto real = next_symbol(&readv, "readv");
+    return measure_io_call(io_kind_e::read, real, fd, iov, iovcnt);
+}
+
+ssize_t writev(int fd, const struct iovec * iov, int iovcnt) {
+    static auto real = next_symbol(&writev, "writev");
+    return measure_io_call(io_kind_e::write, real, fd, iov, iovcnt);
+}
+
+ssize_t recv(int fd, void * buf, size_t len, int flags) {
+    static auto real = next_symbol(&recv, "recv");
+    return measure_io_call(io_kind_e::read, real, fd, buf, len, flags);
+}
+
+ssize_t send(int fd, const void * buf, size_t len, int flags) {
+    static auto real = next_symbol(&send, "send");
+    return measure_io_call(io_kind_e::write, real, fd, buf, len, flags);
+}
+
+ssize_t recvfrom(int fd, void * buf, size_t len, int flags, struct sockaddr * src_addr, socklen_t * addrlen) {
+    static auto real = next_symbol(&recvfrom, "recvfrom");
+    return measure_io_call(io_kind_e::read, real, fd, buf, len, flags, src_addr, addrlen);
+}
+
+ssize_t sendto(int fd, const void * buf, size_t len, int flags, const struct sockaddr * dest_addr, socklen_t addrlen) {
+    static auto real = next_symbol(&sendto, "sendto");
+    return measure_io_call(io_kind_e::write, real, fd, buf, len, flags, dest_addr, addrlen);
+}
+
+ssize_t recvmsg(int fd, struct msghdr * msg, int flags) {
+    static auto real = next_symbol(&recvmsg, "recvmsg");
+    return measure_io_call(io_kind_e::read, real, fd, msg, flags);
+}
+
+ssize_t sendmsg(int fd, const struct msghdr * msg, int flags) {
+    static auto real = next_symbol(&sendmsg, "sendmsg");
+    return measure_io_call(io_kind_e::write, real, fd, msg, flags);
+}
+
+int fsync(int fd) {
+    static auto real = next_symbol(&fsync, "fsync");
+    return measure_io_call(io_kind_e::sync, real, fd);
+}
+
+int fdatasync(int fd) {
+    static auto real = next_symbol(&fdatasync, "fdatasync");
+    return measure_io_call(io_kind_e::sync, real, fd);
+}
+
+}
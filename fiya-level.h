@@ -0,0 +1,86 @@
+#pragma once
+
+#include <mutex>
+#include <atomic>
+
+namespace fiya {
+
+/** Instrumentation level of a scope. A scope is recorded only
+ *  if its level is not finer than the active level.
+ */
+enum class level_t : int {
+    coarse = 0,
+    normal = 1,
+    fine = 2
+};
+
+namespace detail {
+
+/** State of the runtime switch. The members are constant initialized,
+ *  so accessing the function local instance needs no guard.
+ */
+struct level_state_t {
+    /** Finest level that is recorded, or -1 if recording is disabled.
+     *  The enable flag and the level are folded into one value, so the
+     *  check in the RAII wrappers is one relaxed load and one compare.
+     */
+    std::atomic<int> active_level { static_cast<int>(level_t::fine) };
+    /** Level set by set_level(), kept while recording is disabled */
+    std::atomic<int> selected_level { static_cast<int>(level_t::fine) };
+    /** Value of set_enabled() */
+    std::atomic<bool> enabled { true };
+    /** Serializes the setters, so active_level matches the last call */
+    std::mutex mutex;
+
+    void update_active_level() {
+        active_level.store(enabled.load(std::memory_order_relaxed) ? selected_level.load(std::memory_order_relaxed) : -1,
+            std::memory_order_relaxed);
+    }
+};
+
+inline level_state_t& level_state() {
+    static level_state_t state;
+    return state;
+}
+
+}
+
+/** @brief Enables or disables recording in the whole process. Scopes
+ *         opened while enabled are closed normally after disabling,
+ *         scopes opened while disabled are never recorded.
+ */
+inline void set_enabled(bool enabled) {
+    detail::level_state_t& state = detail::level_state();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    state.enabled.store(enabled, std::memory_order_relaxed);
+    state.update_active_level();
+}
+
+/** Returns true if recording is enabled */
+inline bool is_enabled() {
+    return detail::level_state().enabled.load(std::memory_order_relaxed);
+}
+
+/** @brief Sets the finest level that is recorded. The default is
+ *         level_t::fine, i.e. all scopes are recorded.
+ */
+inline void set_level(level_t level) {
+    detail::level_state_t& state = detail::level_state();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    state.selected_level.store(static_cast<int>(level), std::memory_order_relaxed);
+    state.update_active_level();
+}
+
+/** Returns the finest level that is recorded */
+inline level_t get_level() {
+    return static_cast<level_t>(detail::level_state().selected_level.load(std::memory_order_relaxed));
+}
+
+/** @brief Returns true if a scope with the level @level should be recorded.
+ *         The decision is taken once, when the scope is opened.
+ */
+inline bool is_level_active(level_t level) {
+    return static_cast<int>(level) <= detail::level_state().active_level.load(std::memory_order_relaxed);
+}
+
+}
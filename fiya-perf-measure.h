@@ -0,0 +1,374 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+
+#include "fiya-recorder.h"
+
+#if defined(__linux__)
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <sys/resource.h>
+#include <linux/perf_event.h>
+#else
+#error fiya-perf-measure.h is only available on Linux
+#endif
+
+namespace fiya {
+
+/** Struct containing the scheduler and memory events
+ *  counted while the label was active.
+ */
+struct perf_value_t {
+    /** Voluntary and involuntary context switches. */
+    uint64_t context_switches;
+    /** Page faults served without I/O. */
+    uint64_t minor_faults;
+    /** Page faults that required I/O. */
+    uint64_t major_faults;
+    /** Moves of the thread to another CPU. Always zero
+     *  in the getrusage fallback.
+     */
+    uint64_t cpu_migrations;
+    /** CPU cycles. Zero unless hardware events are enabled and available. */
+    uint64_t cycles;
+    /** Retired instructions. Zero unless hardware events are enabled and available. */
+    uint64_t instructions;
+
+    perf_value_t() :
+        context_switches(0ULL),
+        minor_faults(0ULL),
+        major_faults(0ULL),
+        cpu_migrations(0ULL),
+        cycles(0ULL),
+        instructions(0ULL) {}
+
+    perf_value_t operator+(const perf_value_t& other) const {
+        perf_value_t result;
+        result.context_switches = context_switches + other.context_switches;
+        result.minor_faults = minor_faults + other.minor_faults;
+        result.major_faults = major_faults + other.major_faults;
+        result.cpu_migrations = cpu_migrations + other.cpu_migrations;
+        result.cycles = cycles + other.cycles;
+        result.instructions = instructions + other.instructions;
+        return result;
+    }
+
+    perf_value_t operator-(const perf_value_t& other) const {
+        perf_value_t result;
+        result.context_switches = context_switches - other.context_switches;
+        result.minor_faults = minor_faults - other.minor_faults;
+        result.major_faults = major_faults - other.major_faults;
+        result.cpu_migrations = cpu_migrations - other.cpu_migrations;
+        result.cycles = cycles - other.cycles;
+        result.instructions = instructions - other.instructions;
+        return result;
+    }
+
+    perf_value_t& operator+=(const perf_value_t& other) {
+        *this = *this + other;
+        return *this;
+    }
+};
+
+/** @brief Per-thread reader of the counters in perf_value_t.
+ *
+ *  The software events are opened as one perf_event_open group for
+ *  the calling thread, so a single read() returns all of them. If
+ *  perf events are not permitted (e.g. because of perf_event_paranoid
+ *  or seccomp), the reader falls back to getrusage(RUSAGE_THREAD).
+ *
+ *  Hardware events (cycles, instructions) are opened as a separate
+ *  group only when requested, and are silently disabled when the
+ *  CPU or the virtual machine does not provide them. When the PMU is
+ *  shared with other events, the kernel multiplexes the group and the
+ *  counts are scaled by the time the group was enabled over the time
+ *  it was counting.
+ *
+ *  The source of the software events is chosen in the constructor and
+ *  kept. If a read fails, the counters keep their previous values, so
+ *  elapsed() returns zero increments for them.
+ *
+ *  @note Construct the reader in the thread it measures, typically
+ *        as a thread_local object.
+ */
+class perf_counters_t {
+public:
+    /** Constructor
+     *
+     *    @param enable_hardware Try to count cycles and instructions as well
+     */
+    perf_counters_t(bool enable_hardware = false) :
+        m_sw_fd(-1),
+        m_hw_fd(-1)
+    {
+        static const uint64_t sw_events[] = {
+            PERF_COUNT_SW_CONTEXT_SWITCHES,
+            PERF_COUNT_SW_PAGE_FAULTS_MIN,
+            PERF_COUNT_SW_PAGE_FAULTS_MAJ,
+            PERF_COUNT_SW_CPU_MIGRATIONS
+        };
+        m_sw_fd = open_group(PERF_TYPE_SOFTWARE, sw_events, SW_EVENTS);
+
+        if (enable_hardware) {
+            static const uint64_t hw_events[] = {
+                PERF_COUNT_HW_CPU_CYCLES,
+                PERF_COUNT_HW_INSTRUCTIONS
+            };
+            m_hw_fd = open_group(PERF_TYPE_HARDWARE, hw_events, HW_EVENTS);
+        }
+
+        read_sample(m_last);
+    }
+
+    perf_counters_t(const perf_counters_t&) = delete;
+    perf_counters_t& operator=(const perf_counters_t&) = delete;
+
+    /** Destructor */
+    ~perf_counters_t() {
+        close_group(m_sw_fd, SW_EVENTS);
+        close_group(m_hw_fd, HW_EVENTS);
+    }
+
+    /** Returns true if software events come from perf_event_open,
+     *  false if they come from getrusage.
+     */
+    bool uses_perf_events() const {
+        return m_sw_fd >= 0;
+    }
+
+    /** Returns true if cycles and instructions are counted. */
+    bool hardware_enabled() const {
+        return m_hw_fd >= 0;
+    }
+
+    /** @brief Reads the current values of all counters for this thread.
+     *         Cycles and instructions are scaled for multiplexing over the
+     *         whole life of the reader.
+     */
+    perf_value_t read() const {
+        sample_t sample = m_last;
+        read_sample(sample);
+        perf_value_t result = sample.values;
+        result.cycles = scale(result.cycles, sample.hw_enabled, sample.hw_running);
+        result.instructions = scale(result.instructions, sample.hw_enabled, sample.hw_running);
+        return result;
+    }
+
+    /** Returns the counter increments since the previous call
+     *  (or since construction).
+     */
+    perf_value_t elapsed() {
+        sample_t now = m_last;
+        read_sample(now);
+
+        /* Multiplexing is corrected on the increments, the rate since the
+           last call is a better estimate than the rate over the whole life */
+        perf_value_t result = now.values - m_last.values;
+        uint64_t enabled = now.hw_enabled - m_last.hw_enabled;
+        uint64_t running = now.hw_running - m_last.hw_running;
+        result.cycles = scale(result.cycles, enabled, running);
+        result.instructions = scale(result.instructions, enabled, running);
+
+        m_last = now;
+        return result;
+    }
+
+private:
+    /** Number of events in the software group. */
+    static constexpr size_t SW_EVENTS { 4U };
+    /** Number of events in the hardware group. */
+    static constexpr size_t HW_EVENTS { 2U };
+
+    /** Group leader for the software events, -1 if not available. */
+    int m_sw_fd;
+    /** Group leader for the hardware events, -1 if not available. */
+    int m_hw_fd;
+    /** Group members, closed together with the leader. */
+    int m_member_fds[SW_EVENTS + HW_EVENTS];
+    /** Raw counter values and the times of the hardware group */
+    struct sample_t {
+        perf_value_t values;
+        /** Nanoseconds the hardware group was enabled */
+        uint64_t hw_enabled = 0;
+        /** Nanoseconds the hardware group was counting */
+        uint64_t hw_running = 0;
+    };
+
+    /** Values at the previous call to @elapsed. */
+    sample_t m_last;
+
+    /** @brief Reads the counters into @sample. The counters that can't be
+     *         read keep their values in @sample.
+     */
+    void read_sample(sample_t& sample) const {
+        uint64_t values[SW_EVENTS];
+
+        if (m_sw_fd >= 0) {
+            if (read_group(m_sw_fd, values, SW_EVENTS, nullptr)) {
+                sample.values.context_switches = values[0];
+                sample.values.minor_faults = values[1];
+                sample.values.major_faults = values[2];
+                sample.values.cpu_migrations = values[3];
+            }
+        } else {
+            struct rusage usage;
+            if (getrusage(RUSAGE_THREAD, &usage) == 0) {
+                sample.values.context_switches = static_cast<uint64_t>(usage.ru_nvcsw + usage.ru_nivcsw);
+                sample.values.minor_faults = static_cast<uint64_t>(usage.ru_minflt);
+                sample.values.major_faults = static_cast<uint64_t>(usage.ru_majflt);
+            }
+        }
+
+        uint64_t times[2];
+        if (m_hw_fd >= 0 && read_group(m_hw_fd, values, HW_EVENTS, times)) {
+            sample.values.cycles = values[0];
+            sample.values.instructions = values[1];
+            sample.hw_enabled = times[0];
+            sample.hw_running = times[1];
+        }
+    }
+
+    /** @brief Scales @value counted during @running nanoseconds to the
+     *         @enabled nanoseconds the group was scheduled.
+     */
+    static uint64_t scale(uint64_t value, uint64_t enabled, uint64_t running) {
+        if (running == 0 || running >= enabled) {
+            return value;
+        }
+        return static_cast<uint64_t>(static_cast<double>(value) * enabled / running);
+    }
+
+    /** @brief Opens @count events of @type as one group.
+     *  @return The file descriptor of the group leader or -1 if
+     *          any of the events could not be opened.
+     */
+    int open_group(uint32_t type, const uint64_t* events, size_t count) {
+        int* members = (type == PERF_TYPE_SOFTWARE) ? m_member_fds : m_member_fds + SW_EVENTS;
+        int leader = -1;
+
+        for (size_t i { 0U }; i < count; i++) {
+            struct perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = type;
+            attr.config = events[i];
+            attr.disabled = (i == 0) ? 1 : 0;
+            attr.exclude_kernel = (type == PERF_TYPE_HARDWARE) ? 1 : 0;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP;
+            if (type == PERF_TYPE_HARDWARE) {
+                attr.read_format |= PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            }
+
+            /* The software events happen in the kernel: they are never opened
+               with exclude_kernel, which would count them as 0. Unprivileged
+               users get -1 here and the getrusage fallback instead. */
+            int fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0));
+            if (fd < 0) {
+                for (size_t j { 0U }; j < i; j++) {
+                    close(members[j]);
+                }
+                return -1;
+            }
+
+            members[i] = fd;
+            if (i == 0) {
+                leader = fd;
+            }
+        }
+
+        ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        return leader;
+    }
+
+    /** @brief Closes the group opened with @open_group. */
+    void close_group(int leader, size_t count) {
+        if (leader < 0) {
+            return;
+        }
+
+        int* members = (leader == m_sw_fd) ? m_member_fds : m_member_fds + SW_EVENTS;
+        for (size_t i { count }; i > 0; i--) {
+            close(members[i - 1]);
+        }
+    }
+
+    /** @brief Reads all the values of a group with a single read(). If
+     *         @times is given, the group was opened with the time enabled
+     *         and the time running, which are stored there.
+     */
+    static bool read_group(int leader, uint64_t* values, size_t count, uint64_t* times) {
+        /* PERF_FORMAT_GROUP layout: number of events, the times if requested, then the values */
+        uint64_t buffer[3 + SW_EVENTS];
+        size_t header = times ? 3U : 1U;
+        ssize_t expected = static_cast<ssize_t>((header + count) * sizeof(uint64_t));
+        if (::read(leader, buffer, expected) != expected || buffer[0] != count) {
+            return false;
+        }
+
+        if (times) {
+            times[0] = buffer[1];
+            times[1] = buffer[2];
+        }
+        memcpy(values, buffer + header, count * sizeof(uint64_t));
+        return true;
+    }
+};
+
+/** Outputs the number of context switches. */
+inline void perf_context_switches_out(std::ostream& os, const perf_value_t& m) {
+    os << m.context_switches;
+}
+
+/** Outputs the number of minor and major page faults. */
+inline void perf_page_faults_out(std::ostream& os, const perf_value_t& m) {
+    os << m.minor_faults + m.major_faults;
+}
+
+/** Outputs the number of major page faults. */
+inline void perf_major_faults_out(std::ostream& os, const perf_value_t& m) {
+    os << m.major_faults;
+}
+
+/** Outputs the number of CPU migrations. */
+inline void perf_cpu_migrations_out(std::ostream& os, const perf_value_t& m) {
+    os << m.cpu_migrations;
+}
+
+/** RAII wrapper for counting scheduler and memory events. The
+ *  counters are read once at each scope transition and the
+ *  increments are charged to the scope that was active.
+ */
+template <typename LabelType>
+class measure_perf_t {
+public:
+    using measure_type = perf_value_t;
+    using recorder_type = recorder_t<LabelType, measure_type>;
+
+    /** Constructor will open the scope for the label provided to it.
+     *
+     *    @param counters Counter reader of the current thread
+     */
+    measure_perf_t(const LabelType& label, recorder_type * recorder, perf_counters_t * counters) :
+        m_recorder(recorder),
+        m_counters(counters)
+    {
+        m_recorder->cnt() += m_counters->elapsed();
+        m_recorder->begin_scope(label);
+    }
+
+    /** Destructor will close the scope for the currently active label. */
+    ~measure_perf_t() {
+        m_recorder->cnt() += m_counters->elapsed();
+        m_recorder->end_scope();
+    }
+private:
+    recorder_type * m_recorder;
+    perf_counters_t * m_counters;
+};
+
+}
@@ -1,6 +1,7 @@
 
 #pragma once
 
+#include <memory>
 #include <vector>
 #include <ostream>
 #include <cassert>
@@ -183,19 +184,14 @@ public:
     void begin_scope(const LabelType& label) override {
         m_recorder_internal_running = true;
         measure_node_t* node { nullptr };
-        
-        std::vector<measure_node_t*>& children = m_current_node->m_children;
-        for(size_t i { 0U }; i < children.size(); i++) {
-            if (m_label_helper.equal(children[i]->m_label, label)) {
-                node = children[i];
-                break;
-            }
-        }
 
-        if (node == nullptr) {
-            // Node not found, generate a new node
-            children.emplace_back(new measure_node_t(m_label_helper.save(label), m_default_value, m_current_node));
-            node = children.back();
+        // If the allocation of a new node throws, the recorder must
+        // stay usable for the scopes closed during unwinding.
+        try {
+            node = find_or_create_child(m_current_node, label);
+        } catch (...) {
+            m_recorder_internal_running = false;
+            throw;
         }
 
         m_current_node = node;
@@ -310,6 +306,92 @@ public:
     }
 
 
+    /** @brief Calls @visitor for every node in the tree, parents before children.
+     *
+     *  @param visitor Function receiving the labels on the path from the root
+     *                 to the node (both included) and the value of the node
+     */
+    void for_each_path(const std::function<void(const std::vector<LabelType>& path, const MeasureType& value)>& visitor) {
+        m_recorder_internal_running = true;
+        std::vector<LabelType> path;
+        for_each_path(m_root, path, visitor);
+        m_recorder_internal_running = false;
+    }
+
+    /** @brief Calls @op with a modifiable reference to the value of every
+     *         node, parents before children.
+     *
+     *  @param op Function with signature void(MeasureType& value)
+     */
+    template<typename Operation>
+    void for_each_value(const Operation& op) {
+        m_recorder_internal_running = true;
+        for_each_value(m_root, op);
+        m_recorder_internal_running = false;
+    }
+
+    /** @brief Adds the values of @other to the values of this recorder.
+     *         Nodes of @other that don't exist in this recorder are created.
+     *         The roots are merged with each other, regardless of their labels.
+     *
+     *  @param other Recorder to merge from
+     *  @param accumulate_op Function with signature void(MeasureType& dst, const OtherMeasureType& src)
+     *                       that adds a value of @other to a value of this recorder
+     */
+    template<typename OtherMeasureType, typename Operation>
+    void merge(recorder_t<LabelType, OtherMeasureType>& other, const Operation& accumulate_op) {
+        m_recorder_internal_running = true;
+        other.m_recorder_internal_running = true;
+        merge(m_root, other, other.m_root, accumulate_op);
+        other.m_recorder_internal_running = false;
+        m_recorder_internal_running = false;
+    }
+
+    /** @brief Adds the inverted (bottom-up) tree of this recorder to @inverted:
+     *         the children of the root are the labels with self values, their
+     *         children are the callers, and so on up to the outermost scope.
+     *         The self value of each node is added at the end of its caller
+     *         chain, so the total of a label's node is its self value over
+     *         all callers. The self value of the root goes to the root.
+     *         Nodes with the default value, for measures with operator==,
+     *         add no chain.
+     *
+     *  Built in one pass over the nodes, following the parent pointers; no
+     *  paths are materialized. The result is a recorder_t, so it exports in
+     *  every format of the recorder.
+     *
+     *  @param inverted Recorder receiving the inverted tree, e.g. an empty one
+     *  @param accumulate_op Function with signature void(MeasureType& dst, const MeasureType& src)
+     */
+    template<typename Operation>
+    void to_inverted(recorder_t& inverted, const Operation& accumulate_op) {
+        m_recorder_internal_running = true;
+        inverted.m_recorder_internal_running = true;
+        accumulate_op(inverted.m_root->m_value, m_root->m_value);
+        std::vector<measure_node_t*>& children = m_root->m_children;
+        for (size_t i { 0U }; i < children.size(); ++i) {
+            to_inverted(children[i], inverted, accumulate_op);
+        }
+        inverted.m_recorder_internal_running = false;
+        m_recorder_internal_running = false;
+    }
+
+    /** @brief Sets the value of every node to the default value and the value
+     *         of the root to @root_value, and makes the root the current scope.
+     *         The nodes are kept, so recording the same paths again doesn't
+     *         allocate. Used to reuse a recorder, e.g. one recorder per request.
+     *
+     *  @note All scopes need to be closed.
+     */
+    void reset(const MeasureType& root_value) {
+        m_recorder_internal_running = true;
+        assert(m_current_node == m_root);
+        reset_node(m_root);
+        m_root->m_value = root_value;
+        m_current_node = m_root;
+        m_recorder_internal_running = false;
+    }
+
     /** @brief Boilerplate to check if a type has operator+ */
     template <typename T, typename = void>
     struct has_plus_operator : std::false_type {};
@@ -318,8 +400,38 @@ public:
     template <typename T>
     struct has_plus_operator<T, std::void_t<decltype(std::declval<T>() + std::declval<T>())>> : std::true_type {};
 
+    /** @brief Boilerplate to check if a type has operator== */
+    template <typename T, typename = void>
+    struct has_equal_operator : std::false_type {};
+
+    /** @brief Boilerplate to check if a type has operator== */
+    template <typename T>
+    struct has_equal_operator<T, std::void_t<decltype(std::declval<T>() == std::declval<T>())>> : std::true_type {};
+
     using my_report_type = report_t<LabelType, MeasureType>;
 
+    /** @brief Adds the values of @other to the values of this recorder
+     *         using operator+. See the overload above.
+     */
+    template <typename T = MeasureType>
+    std::enable_if_t<has_plus_operator<T>::value>
+    merge(recorder_t& other) {
+        merge(other, [] (MeasureType& dst, const MeasureType& src) {
+            dst = dst + src;
+        });
+    }
+
+    /** @brief Adds the inverted tree to @inverted using operator+.
+     *         See the overload above.
+     */
+    template <typename T = MeasureType>
+    std::enable_if_t<has_plus_operator<T>::value>
+    to_inverted(recorder_t& inverted) {
+        to_inverted(inverted, [] (MeasureType& dst, const MeasureType& src) {
+            dst = dst + src;
+        });
+    }
+
     /** @brief Converts the measured values to per label report.
      *  @param accumulate_op Pointer to the accumulate operations (needed to generate `total` value).
      */
@@ -376,7 +488,99 @@ private:
     measure_node_t* m_root;
     /** Scope current note */
     measure_node_t* m_current_node;
+
+    /** Recorders with other measure types need access to the nodes for merging. */
+    template<typename OtherLabelType, typename OtherMeasureType>
+    friend class recorder_t;
+
+    /** @brief Returns the child of @node with the label @label. If there
+     *         is no such child, a new node is created.
+     */
+    measure_node_t* find_or_create_child(measure_node_t* node, const LabelType& label) {
+        std::vector<measure_node_t*>& children = node->m_children;
+        for(size_t i { 0U }; i < children.size(); i++) {
+            if (m_label_helper.equal(children[i]->m_label, label)) {
+                return children[i];
+            }
+        }
+
+        // Node not found, generate a new node
+        std::unique_ptr<measure_node_t> new_node(new measure_node_t(m_label_helper.save(label), m_default_value, node));
+        children.push_back(new_node.get());
+        return new_node.release();
+    }
+
+    /** @brief Merges @other_node of recorder @other into @node recursively. */
+    template<typename OtherMeasureType, typename Operation>
+    void merge(
+        measure_node_t* node,
+        recorder_t<LabelType, OtherMeasureType>& other,
+        typename recorder_t<LabelType, OtherMeasureType>::measure_node_t* other_node,
+        const Operation& accumulate_op)
+    {
+        accumulate_op(node->m_value, other_node->m_value);
+
+        for (size_t i { 0U }; i < other_node->m_children.size(); ++i) {
+            auto* other_child = other_node->m_children[i];
+            measure_node_t* child = find_or_create_child(node, other.m_label_helper.restore(other_child->m_label));
+            merge(child, other, other_child, accumulate_op);
+        }
+    }
     
+    /** @brief Adds the value of @node at the end of its caller chain in
+     *         @inverted, then does the same for its children.
+     */
+    template<typename Operation>
+    void to_inverted(measure_node_t* node, recorder_t& inverted, const Operation& accumulate_op) {
+        if (!is_default_value(node->m_value)) {
+            measure_node_t* inverted_node = inverted.m_root;
+            for (measure_node_t* caller { node }; caller != m_root; caller = caller->m_parent) {
+                inverted_node = inverted.find_or_create_child(inverted_node, m_label_helper.restore(caller->m_label));
+            }
+            accumulate_op(inverted_node->m_value, node->m_value);
+        }
+
+        std::vector<measure_node_t*>& children = node->m_children;
+        for (size_t i { 0U }; i < children.size(); ++i) {
+            to_inverted(children[i], inverted, accumulate_op);
+        }
+    }
+
+    /** @brief Returns true if @value equals the default value */
+    template <typename T = MeasureType>
+    std::enable_if_t<has_equal_operator<T>::value, bool>
+    is_default_value(const MeasureType& value) const {
+        return value == m_default_value;
+    }
+
+    /** @brief Measures without operator== are never taken as the default value */
+    template <typename T = MeasureType>
+    std::enable_if_t<!has_equal_operator<T>::value, bool>
+    is_default_value(const MeasureType&) const {
+        return false;
+    }
+
+    /** @brief Calls @op for the value of the node and all of its children. */
+    template<typename Operation>
+    void for_each_value(measure_node_t* node, const Operation& op) {
+        op(node->m_value);
+
+        std::vector<measure_node_t*>& children = node->m_children;
+        for (size_t i { 0U }; i < children.size(); ++i) {
+            for_each_value(children[i], op);
+        }
+    }
+
+    /** @brief Sets the value of the node and all of its children to the default value. */
+    void reset_node(measure_node_t* node) {
+        node->m_value = m_default_value;
+
+        std::vector<measure_node_t*>& children = node->m_children;
+        for (size_t i { 0U }; i < children.size(); ++i) {
+            reset_node(children[i]);
+        }
+    }
+
     /** @brief Deletes the node and all of it children. */
     void delete_node(measure_node_t* node) {
         std::vector<measure_node_t*>& children = node->m_children;
@@ -427,6 +631,22 @@ private:
         }
     }
 
+    /** @brief Visits the node and its children recursively. */
+    void for_each_path(
+        measure_node_t* node,
+        std::vector<LabelType>& path,
+        const std::function<void(const std::vector<LabelType>& path, const MeasureType& value)>& visitor
+    ) {
+        path.push_back(m_label_helper.restore(node->m_label));
+        visitor(path, node->m_value);
+
+        std::vector<measure_node_t*>& children = node->m_children;
+        for (size_t i { 0U }; i < children.size(); ++i) {
+            for_each_path(children[i], path, visitor);
+        }
+        path.pop_back();
+    }
+
     /**  @brief Generates report for the current node in the tree. */
     template<typename Operation>
     MeasureType to_report(measure_node_t* node, my_report_type& report, const Operation& op) {
@@ -0,0 +1,231 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+#include "fiya-time-measure.h"
+
+namespace fiya {
+
+/** @brief Decides which invocations of a scope are recorded: every Nth
+ *         invocation, or in random mode on average every Nth one, with
+ *         the distance between samples drawn uniformly from [1, 2N - 1].
+ *         Random mode avoids aliasing with periodic call patterns.
+ *
+ *  Declare one sampler per scope and thread, as a static thread_local
+ *  next to the scope. The constructor is constexpr, so the sampler is
+ *  constant initialized and accessing it needs no guard.
+ *
+ *  @code
+ *  static thread_local sampler_t sampler(1000);
+ *  sampled_measure_time_t<const char*> m("hash", &recorder, sampler);
+ *  @endcode
+ */
+class sampler_t {
+public:
+    /** Constructor
+     *
+     *    @param period Average number of invocations per recorded invocation
+     *    @param random Use random distances between samples instead of a fixed one
+     */
+    constexpr sampler_t(uint32_t period, bool random = false) :
+        m_period(period > 0 ? period : 1),
+        m_random(random),
+        m_countdown(1),
+        m_weight(1),
+        m_state(0),
+        m_calls(0),
+        m_samples(0)
+    { }
+
+    /** @brief Called on each invocation. Returns 0 if the invocation is not
+     *         recorded, otherwise the number of invocations the sample stands
+     *         for: itself and the invocations since the previous sample.
+     */
+    uint32_t next() {
+        if (--m_countdown != 0) {
+            return 0;
+        }
+        return take_sample();
+    }
+
+    /** Returns the number of invocations since the last sample, not yet recorded */
+    uint32_t pending() const {
+        return m_weight - m_countdown;
+    }
+
+    /** Returns the average number of invocations per sample */
+    uint32_t period() const {
+        return m_period;
+    }
+
+    /** @brief Changes the average number of invocations per sample. The new
+     *         period is used after the next sample, or right away if
+     *         @immediately is set, in which case the invocations since the
+     *         last sample are dropped from calls().
+     */
+    void set_period(uint32_t period, bool immediately = false) {
+        m_period = period > 0 ? period : 1;
+        if (immediately) {
+            m_weight = m_period;
+            m_countdown = m_period;
+        }
+    }
+
+    /** Returns the number of invocations up to the last sample */
+    uint64_t calls() const {
+        return m_calls;
+    }
+
+    /** Returns the number of samples taken */
+    uint64_t samples() const {
+        return m_samples;
+    }
+private:
+    /** Average distance between samples */
+    uint32_t m_period;
+    /** True if the distance is random */
+    bool m_random;
+    /** Invocations until the next sample */
+    uint32_t m_countdown;
+    /** Distance between the previous sample and the next one */
+    uint32_t m_weight;
+    /** xorshift state of the random mode, seeded on the first sample */
+    uint32_t m_state;
+    /** Invocations up to the last sample */
+    uint64_t m_calls;
+    /** Samples taken */
+    uint64_t m_samples;
+
+    uint32_t take_sample() {
+        uint32_t weight = m_weight;
+        m_calls += weight;
+        m_samples++;
+
+        if (m_random && m_period > 1) {
+            if (m_state == 0) {
+                m_state = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(this) >> 4) | 1U;
+            }
+            m_state ^= m_state << 13;
+            m_state ^= m_state >> 17;
+            m_state ^= m_state << 5;
+            m_weight = 1 + m_state % (2 * m_period - 1);
+        } else {
+            m_weight = m_period;
+        }
+
+        m_countdown = m_weight;
+        return weight;
+    }
+};
+
+/** @brief Time value of a sampled scope. The duration is extrapolated:
+ *         each recorded invocation counts as many times as the invocations
+ *         it stands for.
+ */
+class sampled_time_value_t: public time_value_t {
+public:
+    /** Number of invocations of the scope, including the ones that were not recorded */
+    uint64_t calls = 0;
+    /** Number of invocations that were recorded */
+    uint64_t samples = 0;
+
+    static sampled_time_value_t now() {
+        sampled_time_value_t result;
+        static_cast<time_value_t&>(result) = time_value_t::now();
+        return result;
+    }
+
+    sampled_time_value_t operator+(const sampled_time_value_t& other) const {
+        sampled_time_value_t result;
+        static_cast<time_value_t&>(result) = time_value_t::operator+(other);
+        result.calls = calls + other.calls;
+        result.samples = samples + other.samples;
+        return result;
+    }
+};
+
+/** @brief RAII wrapper for measuring time of a scope that runs too often to
+ *         be measured on every invocation. Only the invocations chosen by
+ *         the sampler open the scope and read the clock; the others cost
+ *         a decrement of the sampler's counter and a branch.
+ *
+ *  A recorded invocation standing for k invocations adds k times its self
+ *  time, over the whole invocation, to the scope and k to the call count,
+ *  so call counts are exact (up to sampler_t::pending()). The self time of
+ *  the k - 1 unrecorded invocations was accounted to the enclosing scope,
+ *  so the extrapolated part is subtracted from it. The estimate assumes the
+ *  unrecorded invocations ran in the same enclosing scope as the recorded
+ *  one; nesting sampled scopes in sampled scopes multiplies the error.
+ *
+ *  Scopes opened inside the invocation are recorded as measured, without
+ *  extrapolation: below this scope in the recorded invocations, and below
+ *  the enclosing scope in the others. Their total is exact.
+ *
+ *  A scope whose @level is not active doesn't count the invocation in the
+ *  sampler either.
+ *
+ *  The scope can be mixed with measure_time_t<LabelType, sampled_time_value_t>
+ *  in the same recorder.
+ */
+template <typename LabelType>
+class sampled_measure_time_t {
+public:
+    using measure_type = sampled_time_value_t;
+    using recorder_type = recorder_t<LabelType, measure_type>;
+
+    sampled_measure_time_t(const LabelType& label, recorder_type * recorder, sampler_t& sampler, level_t level = level_t::normal) :
+        m_recorder(nullptr),
+        m_weight(is_level_active(level) ? sampler.next() : 0)
+    {
+        if (m_weight == 0) {
+            return;
+        }
+        m_recorder = recorder;
+        m_recorder->cnt().m_duration += get_thread_time<void>() - m_recorder->cnt().m_start;
+        m_recorder->begin_scope(label);
+        m_duration = m_recorder->cnt().m_duration;
+        m_recorder->cnt().m_start = get_thread_time<void>();
+    }
+
+    ~sampled_measure_time_t() {
+        if (m_recorder == nullptr) {
+            return;
+        }
+        m_recorder->cnt().m_duration += get_thread_time<void>() - m_recorder->cnt().m_start;
+
+        /* The self time of the whole invocation, also before and between child scopes */
+        auto self = m_recorder->cnt().m_duration - m_duration;
+        m_recorder->cnt().m_duration += self * (m_weight - 1);
+        m_recorder->cnt().calls += m_weight;
+        m_recorder->cnt().samples++;
+
+        m_recorder->end_scope();
+        m_recorder->cnt().m_duration -= self * (m_weight - 1);
+        m_recorder->cnt().m_start = get_thread_time<void>();
+    }
+private:
+    /** Pointer to the recorder, nullptr if the invocation is not recorded */
+    recorder_type * m_recorder;
+    /** Number of invocations this one stands for */
+    uint32_t m_weight;
+    /** Self time of the scope when the invocation started */
+    std::chrono::high_resolution_clock::duration m_duration {};
+};
+
+/** @brief Outputs the extrapolated self time in microseconds, for
+ *         recorder_t::to_collapsed_stacks. Negative estimates of the
+ *         enclosing scopes are written as zero.
+ */
+inline void sampled_time_out(std::ostream& os, const sampled_time_value_t& m) {
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(m.get_duration()).count();
+    os << (us > 0 ? us : 0);
+}
+
+/** Outputs the call count, for recorder_t::to_collapsed_stacks */
+inline void sampled_calls_out(std::ostream& os, const sampled_time_value_t& m) {
+    os << m.calls;
+}
+
+}
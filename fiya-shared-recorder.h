@@ -0,0 +1,518 @@
+#pragma once
+
+#include <new>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <algorithm>
+#include <functional>
+#include <type_traits>
+
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include "fiya-time-measure.h"
+
+namespace fiya {
+
+namespace detail {
+
+/** @brief Label as stored in the shared region: the value itself, which
+ *         must be the same in all processes, e.g. an integer.
+ */
+template <typename LabelType>
+struct shared_label_t {
+    static_assert(std::is_trivially_copyable<LabelType>::value, "Labels in shared memory must be trivially copyable");
+
+    using stored_type = LabelType;
+
+    static bool save(stored_type& stored, const LabelType& label, char *, std::atomic<uint64_t>&, uint64_t) {
+        stored = label;
+        return true;
+    }
+
+    static bool equal(const stored_type& stored, const LabelType& label, const char *) {
+        return stored == label;
+    }
+
+    static LabelType restore(const stored_type& stored, const char *) {
+        return stored;
+    }
+};
+
+/** @brief Strings are copied into the label area of the shared region,
+ *         so labels built at runtime in a worker are readable in the master.
+ */
+template <>
+struct shared_label_t<const char*> {
+    /** Offset of the string in the label area */
+    using stored_type = uint64_t;
+
+    static bool save(stored_type& stored, const char* const & label, char * area, std::atomic<uint64_t>& used, uint64_t capacity) {
+        uint64_t size = strlen(label) + 1;
+        uint64_t offset = used.fetch_add(size, std::memory_order_relaxed);
+        if (offset + size > capacity) {
+            return false;
+        }
+        memcpy(area + offset, label, size);
+        stored = offset;
+        return true;
+    }
+
+    static bool equal(const stored_type& stored, const char* const & label, const char * area) {
+        return strcmp(area + stored, label) == 0;
+    }
+
+    static const char* restore(const stored_type& stored, const char * area) {
+        return area + stored;
+    }
+};
+
+/** Interface for resetting the cursors of the forking thread in the child */
+class shared_cursor_base_t {
+public:
+    virtual ~shared_cursor_base_t() = default;
+    virtual void on_fork_child() = 0;
+    /** Thread that owns the cursor */
+    std::thread::id owner;
+};
+
+/** @brief Process-local registry of the cursors, with the pthread_atfork
+ *         handlers that reset them in a forked child.
+ */
+struct shared_cursor_registry_t {
+    std::mutex mutex;
+    std::vector<shared_cursor_base_t*> cursors;
+    std::once_flag atfork_once;
+
+    static shared_cursor_registry_t& get() {
+        static shared_cursor_registry_t registry;
+        return registry;
+    }
+
+    void add(shared_cursor_base_t * cursor) {
+        std::call_once(atfork_once, [] {
+            pthread_atfork(prepare, parent, child);
+        });
+        std::lock_guard<std::mutex> lock(mutex);
+        cursors.push_back(cursor);
+    }
+
+    void remove(shared_cursor_base_t * cursor) {
+        std::lock_guard<std::mutex> lock(mutex);
+        cursors.erase(std::remove(cursors.begin(), cursors.end(), cursor), cursors.end());
+    }
+
+    static void prepare() {
+        get().mutex.lock();
+    }
+
+    static void parent() {
+        get().mutex.unlock();
+    }
+
+    /** @brief Only the forking thread exists in the child: its cursors move
+     *         to slots of their own, the cursors of the other threads are dropped.
+     */
+    static void child() {
+        shared_cursor_registry_t& registry = get();
+        auto self = std::this_thread::get_id();
+        std::vector<shared_cursor_base_t*> alive;
+        for (shared_cursor_base_t * cursor : registry.cursors) {
+            if (cursor->owner == self) {
+                cursor->on_fork_child();
+                alive.push_back(cursor);
+            }
+        }
+        registry.cursors.swap(alive);
+        registry.mutex.unlock();
+    }
+};
+
+}
+
+/** @brief Recorder tree in a MAP_SHARED region, shared by pre-forked worker
+ *         processes. Create it in the master before forking; the workers
+ *         record into it through shared_recorder_t::cursor_t, and the master
+ *         can export the combined profile at any time.
+ *
+ *  Nodes are inserted lock-free: a new node is prepended to its parent's
+ *  child list with a compare-and-swap, so processes can insert concurrently.
+ *  Each cursor, i.e. each recording thread of each process, claims a counter
+ *  slot and only writes its slot of each node, so counters need no atomics.
+ *  A cursor copied into a child by fork() is moved to a new slot by a
+ *  pthread_atfork handler. A slot is released when its cursor is destroyed,
+ *  or claimed again once the process that owns it has exited, so recycled
+ *  workers reuse the slots; the values recorded in them stay.
+ *
+ *  The storage is fixed at construction: scopes that don't fit into
+ *  @max_nodes are accounted to their parent, and cursors that find no free
+ *  slot of the @max_slots record nothing. Both count in dropped(), as slots
+ *  are never shared. Labels must be the same in all processes, e.g.
+ *  integers; const char* labels are copied into the shared region.
+ *  The MeasureType must be trivially copyable, e.g. uint64_t or time_value_t.
+ *  Reading while the workers record can see partially updated values, as
+ *  with any live profile.
+ */
+template <typename LabelType, typename MeasureType>
+class shared_recorder_t {
+    using label_traits = detail::shared_label_t<LabelType>;
+    using stored_label_type = typename label_traits::stored_type;
+
+    static_assert(std::is_trivially_copyable<MeasureType>::value, "Measures in shared memory must be trivially copyable");
+    static_assert(std::atomic<uint32_t>::is_always_lock_free, "Shared nodes need lock-free atomics");
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "Shared nodes need lock-free atomics");
+
+    struct node_t {
+        stored_label_type label;
+        uint32_t parent;
+        /** Head of the child list and next sibling, 0 is none */
+        std::atomic<uint32_t> first_child;
+        std::atomic<uint32_t> next_sibling;
+    };
+
+    struct header_t {
+        std::atomic<uint32_t> node_count;
+        /** Number of slots ever claimed, the claimed slots are below it */
+        std::atomic<uint32_t> slot_count;
+        std::atomic<uint64_t> label_used;
+        std::atomic<uint64_t> dropped;
+    };
+public:
+    /** @brief Recording interface of one thread of one process, for
+     *         measure_time_t and the other RAII wrappers through their
+     *         RecorderType parameter.
+     */
+    class cursor_t: public counter_interface_t<MeasureType>, public scoping_interface_t<LabelType>, private detail::shared_cursor_base_t {
+    public:
+        cursor_t(shared_recorder_t * recorder) :
+            m_recorder(recorder),
+            m_slot(recorder->claim_slot()),
+            m_scratch(recorder->m_default_value),
+            m_current(0U),
+            m_spare(0U),
+            m_overflow_depth(0U)
+        {
+            owner = std::this_thread::get_id();
+            detail::shared_cursor_registry_t::get().add(this);
+            /* The time of the root counts from now */
+            if constexpr (std::is_base_of<time_value_t, MeasureType>::value) {
+                MeasureType from = cnt();
+                time_value_t::handoff(from, cnt());
+            }
+        }
+
+        ~cursor_t() {
+            detail::shared_cursor_registry_t::get().remove(this);
+            m_recorder->release_slot(m_slot);
+        }
+
+        cursor_t(const cursor_t&) = delete;
+        cursor_t& operator=(const cursor_t&) = delete;
+
+        void begin_scope(const LabelType& label) override {
+            if (!has_slot()) {
+                m_recorder->m_header->dropped.fetch_add(1U, std::memory_order_relaxed);
+                return;
+            }
+            if (m_overflow_depth > 0) {
+                m_overflow_depth++;
+                return;
+            }
+            uint32_t child = m_recorder->find_or_insert(m_current, label, m_spare);
+            if (child == 0) {
+                m_overflow_depth++;
+                return;
+            }
+            m_current = child;
+        }
+
+        void end_scope() override {
+            if (m_overflow_depth > 0) {
+                m_overflow_depth--;
+            } else if (m_current != 0) {
+                m_current = m_recorder->m_nodes[m_current].parent;
+            }
+        }
+
+        void end_scope(const LabelType&) override {
+            end_scope();
+        }
+
+        const MeasureType& cnt() const override {
+            return has_slot() ? m_recorder->value(m_current, m_slot) : m_scratch;
+        }
+
+        MeasureType& cnt() override {
+            return has_slot() ? m_recorder->value(m_current, m_slot) : m_scratch;
+        }
+
+        bool recorder_internal_running() const override {
+            return false;
+        }
+
+        /** Returns the counter slot of the cursor */
+        uint32_t slot() const {
+            return m_slot;
+        }
+
+        /** Returns false if no slot was free, the cursor then records nothing */
+        bool has_slot() const {
+            return m_slot < m_recorder->m_max_slots;
+        }
+    private:
+        shared_recorder_t * m_recorder;
+        uint32_t m_slot;
+        /** Receives the values of a cursor without slot */
+        MeasureType m_scratch;
+        uint32_t m_current;
+        /** Node allocated by an insertion that lost the race, reused for the next one */
+        uint32_t m_spare;
+        uint64_t m_overflow_depth;
+
+        /** @brief Continues in a slot of its own. The scopes open at the fork
+         *         stay open; a running time value restarts now.
+         */
+        void on_fork_child() override {
+            MeasureType from = cnt();
+            m_slot = m_recorder->claim_slot();
+            m_spare = 0U;
+            if constexpr (std::is_base_of<time_value_t, MeasureType>::value) {
+                time_value_t::handoff(from, cnt());
+            }
+        }
+    };
+
+    /** Constructor
+     *
+     *    @param default_value Measure value used to initialize newly constructed nodes
+     *    @param root_label    Name of the root label
+     *    @param max_nodes     Maximum number of nodes
+     *    @param max_slots     Maximum number of cursors, i.e. recording threads of all processes
+     *    @param label_bytes   Size of the label area, used for const char* labels
+     */
+    shared_recorder_t(MeasureType default_value, const LabelType& root_label,
+                      uint32_t max_nodes = 1U << 16, uint32_t max_slots = 64, uint64_t label_bytes = 1U << 20) :
+        m_default_value(default_value),
+        m_max_nodes(std::max<uint32_t>(max_nodes, 1U)),
+        m_max_slots(std::max<uint32_t>(max_slots, 1U)),
+        m_label_bytes(label_bytes)
+    {
+        size_t owners_offset = align(sizeof(header_t));
+        size_t nodes_offset = align(owners_offset + sizeof(std::atomic<pid_t>) * m_max_slots);
+        size_t values_offset = align(nodes_offset + sizeof(node_t) * m_max_nodes);
+        size_t labels_offset = align(values_offset + sizeof(MeasureType) * m_max_nodes * m_max_slots);
+        m_size = labels_offset + m_label_bytes;
+
+        void * region = mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (region == MAP_FAILED) {
+            throw std::bad_alloc();
+        }
+        m_region = static_cast<char*>(region);
+        m_header = new (m_region) header_t{};
+        m_owners = reinterpret_cast<std::atomic<pid_t>*>(m_region + owners_offset);
+        for (uint32_t slot { 0U }; slot < m_max_slots; slot++) {
+            new (&m_owners[slot]) std::atomic<pid_t>(0);
+        }
+        m_nodes = reinterpret_cast<node_t*>(m_region + nodes_offset);
+        m_values = reinterpret_cast<MeasureType*>(m_region + values_offset);
+        m_labels = m_region + labels_offset;
+
+        m_header->node_count.store(0U);
+        uint32_t root = allocate_node(0U, root_label);
+        (void) root;
+        for (uint32_t slot { 0U }; slot < m_max_slots; slot++) {
+            value(0U, slot) = default_value;
+        }
+    }
+
+    /** Unmaps the region in this process */
+    ~shared_recorder_t() {
+        munmap(m_region, m_size);
+    }
+
+    shared_recorder_t(const shared_recorder_t&) = delete;
+    shared_recorder_t& operator=(const shared_recorder_t&) = delete;
+
+    /** Returns the number of nodes */
+    uint32_t node_count() const {
+        return m_header->node_count.load(std::memory_order_acquire);
+    }
+
+    /** Returns the number of counter slots claimed so far, including released ones */
+    uint32_t slot_count() const {
+        return std::min(m_header->slot_count.load(std::memory_order_acquire), m_max_slots);
+    }
+
+    /** @brief Returns the number of scopes that didn't fit into the nodes, or
+     *         that were opened by cursors without a slot.
+     */
+    uint64_t dropped() const {
+        return m_header->dropped.load(std::memory_order_relaxed);
+    }
+
+    /** @brief Adds the combined values of all slots to @recorder, which
+     *         then exports them, e.g. with to_collapsed_stacks or to_report.
+     */
+    void to_recorder(recorder_t<LabelType, MeasureType>& recorder) const {
+        recorder.cnt() = recorder.cnt() + combined(0U);
+        to_recorder(recorder, 0U);
+    }
+
+    /** Writes the combined profile in the collapsed stack format */
+    void to_collapsed_stacks(
+        std::ostream& os,
+        const std::function<void(std::ostream& os, const LabelType& l)> & l_out,
+        const std::function<void(std::ostream& os, const MeasureType& m)> & m_out) const
+    {
+        recorder_t<LabelType, MeasureType> recorder(m_default_value, label_traits::restore(m_nodes[0].label, m_labels), m_default_value);
+        to_recorder(recorder);
+        recorder.to_collapsed_stacks(os, l_out, m_out);
+    }
+private:
+    MeasureType m_default_value;
+    uint32_t m_max_nodes;
+    uint32_t m_max_slots;
+    uint64_t m_label_bytes;
+    /** The shared region: header, nodes, values and labels */
+    char * m_region;
+    size_t m_size;
+    header_t * m_header;
+    /** Process owning each slot, 0 if the slot is free */
+    std::atomic<pid_t> * m_owners;
+    node_t * m_nodes;
+    /** Values of node n in slot s at n * m_max_slots + s */
+    MeasureType * m_values;
+    char * m_labels;
+
+    static size_t align(size_t offset) {
+        return (offset + 63) & ~static_cast<size_t>(63);
+    }
+
+    MeasureType& value(uint32_t node, uint32_t slot) const {
+        return m_values[static_cast<size_t>(node) * m_max_slots + slot];
+    }
+
+    /** @brief Returns a free slot, or a slot of a process that has exited,
+     *         owned by this process from now on. Returns m_max_slots if none.
+     */
+    uint32_t claim_slot() {
+        pid_t self = getpid();
+        for (uint32_t slot { 0U }; slot < m_max_slots; slot++) {
+            pid_t owner = m_owners[slot].load(std::memory_order_acquire);
+            if (owner == 0 || (owner != self && kill(owner, 0) != 0 && errno == ESRCH)) {
+                if (m_owners[slot].compare_exchange_strong(owner, self, std::memory_order_acq_rel)) {
+                    uint32_t count = m_header->slot_count.load(std::memory_order_relaxed);
+                    while (count <= slot && !m_header->slot_count.compare_exchange_weak(count, slot + 1, std::memory_order_acq_rel)) {
+                    }
+                    return slot;
+                }
+            }
+        }
+        return m_max_slots;
+    }
+
+    /** @brief Releases @slot if this process owns it: a cursor copied by fork()
+     *         from another thread still refers to a slot of the parent.
+     */
+    void release_slot(uint32_t slot) {
+        if (slot < m_max_slots) {
+            pid_t self = getpid();
+            m_owners[slot].compare_exchange_strong(self, 0, std::memory_order_acq_rel);
+        }
+    }
+
+    /** Returns a new node with @label under @parent, or 0 if the region is full */
+    uint32_t allocate_node(uint32_t parent, const LabelType& label) {
+        /* Never counts past the end: a wrapped counter would hand out the root */
+        uint32_t node = m_header->node_count.load(std::memory_order_relaxed);
+        do {
+            if (node >= m_max_nodes) {
+                return 0;
+            }
+        } while (!m_header->node_count.compare_exchange_weak(node, node + 1U, std::memory_order_relaxed));
+        node_t * n = new (&m_nodes[node]) node_t{};
+        if (!label_traits::save(n->label, label, m_labels, m_header->label_used, m_label_bytes)) {
+            return 0;
+        }
+        n->parent = parent;
+        for (uint32_t slot { 0U }; slot < m_max_slots; slot++) {
+            value(node, slot) = m_default_value;
+        }
+        return node;
+    }
+
+    /** @brief Returns the child of @parent with @label, inserting it if needed,
+     *         or 0 if the region is full. @spare is a node allocated by an earlier
+     *         insertion that lost the race.
+     */
+    uint32_t find_or_insert(uint32_t parent, const LabelType& label, uint32_t& spare) {
+        std::atomic<uint32_t>& first_child = m_nodes[parent].first_child;
+        uint32_t head = first_child.load(std::memory_order_acquire);
+        uint32_t stop = 0U;
+        for (;;) {
+            for (uint32_t n { head }; n != stop; n = m_nodes[n].next_sibling.load(std::memory_order_acquire)) {
+                if (label_traits::equal(m_nodes[n].label, label, m_labels)) {
+                    return n;
+                }
+            }
+
+            if (spare == 0) {
+                spare = allocate_node(parent, label);
+                if (spare == 0) {
+                    m_header->dropped.fetch_add(1U, std::memory_order_relaxed);
+                    return 0;
+                }
+            } else {
+                node_t& n = m_nodes[spare];
+                n.parent = parent;
+                n.first_child.store(0U, std::memory_order_relaxed);
+                /* The label of a spare that lost the race for the same label is already saved */
+                if (!label_traits::equal(n.label, label, m_labels) &&
+                    !label_traits::save(n.label, label, m_labels, m_header->label_used, m_label_bytes)) {
+                    m_header->dropped.fetch_add(1U, std::memory_order_relaxed);
+                    return 0;
+                }
+            }
+
+            /* Publish the node; on failure only the newly inserted children need checking */
+            uint32_t old_head = head;
+            m_nodes[spare].next_sibling.store(head, std::memory_order_relaxed);
+            if (first_child.compare_exchange_strong(head, spare, std::memory_order_release, std::memory_order_acquire)) {
+                uint32_t result = spare;
+                spare = 0U;
+                return result;
+            }
+            stop = old_head;
+        }
+    }
+
+    /** Sums the values of @node over the claimed slots */
+    MeasureType combined(uint32_t node) const {
+        MeasureType result = value(node, 0U);
+        uint32_t slots = slot_count();
+        for (uint32_t slot { 1U }; slot < slots; slot++) {
+            result = result + value(node, slot);
+        }
+        return result;
+    }
+
+    void to_recorder(recorder_t<LabelType, MeasureType>& recorder, uint32_t node) const {
+        for (uint32_t child { m_nodes[node].first_child.load(std::memory_order_acquire) }; child != 0;
+             child = m_nodes[child].next_sibling.load(std::memory_order_acquire)) {
+            recorder.begin_scope(label_traits::restore(m_nodes[child].label, m_labels));
+            recorder.cnt() = recorder.cnt() + combined(child);
+            to_recorder(recorder, child);
+            recorder.end_scope();
+        }
+    }
+};
+
+}
@@ -0,0 +1,178 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <ostream>
+#include <algorithm>
+#include <functional>
+#include "fiya-recorder.h"
+
+#if defined(__GLIBC__)
+#include <pthread.h>
+#define FIYA_USE_PTHREAD_STACK_BASE
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define FIYA_FRAME_ADDRESS() (_AddressOfReturnAddress())
+#define FIYA_ALWAYS_INLINE __forceinline
+#else
+#define FIYA_FRAME_ADDRESS() (__builtin_frame_address(0))
+#define FIYA_ALWAYS_INLINE inline __attribute__((always_inline))
+#endif
+
+namespace fiya {
+
+/** Struct containing information about stack usage */
+struct stack_usage_t {
+    /** Maximum distance in bytes between the thread's stack
+     *  base and the frame that opened the scope.
+     */
+    uint64_t max_depth;
+
+    stack_usage_t() :
+        max_depth(0ULL) {}
+};
+
+/** @brief Returns the address where the stack of the current thread begins.
+ *
+ *  On glibc this is the top of the stack reported by pthread_getattr_np.
+ *  Elsewhere the frame address of the first call in the thread is used,
+ *  so depths are relative to the first measured scope.
+ */
+inline uintptr_t get_stack_base(uintptr_t frame) {
+    static thread_local uintptr_t stack_base = 0;
+
+    if (stack_base == 0) {
+#ifdef FIYA_USE_PTHREAD_STACK_BASE
+        pthread_attr_t attr;
+        void * stack_addr = nullptr;
+        size_t stack_size = 0;
+        if (pthread_getattr_np(pthread_self(), &attr) == 0) {
+            if (pthread_attr_getstack(&attr, &stack_addr, &stack_size) == 0) {
+                stack_base = reinterpret_cast<uintptr_t>(stack_addr) + stack_size;
+            }
+            pthread_attr_destroy(&attr);
+        }
+#endif
+        if (stack_base == 0) {
+            stack_base = frame;
+        }
+    }
+
+    return stack_base;
+}
+
+/** RAII wrapper for measuring stack usage. When the scope is opened, the
+ *  distance between the stack base and the frame of the function declaring
+ *  the wrapper is recorded, and the node keeps the maximum.
+ *
+ *  @note The stack is assumed to grow downwards, as on all mainstream platforms.
+ *        The stack used below the last scope of a path (e.g. by leaf functions
+ *        without a scope) is not seen.
+ */
+template<typename LabelType>
+class measure_stack_t {
+public:
+    /** This RAII wrapper requires a pointer to this recorder_type */
+    using recorder_type = recorder_t<LabelType, stack_usage_t>;
+
+    /** Constructor will open the scope for the label provided to it. It is
+     *  always inlined, so the frame address is the one of the caller.
+     */
+    FIYA_ALWAYS_INLINE measure_stack_t(const LabelType& label, recorder_type* recorder) :
+        m_recorder(recorder)
+    {
+        uintptr_t frame = reinterpret_cast<uintptr_t>(FIYA_FRAME_ADDRESS());
+        uintptr_t base = get_stack_base(frame);
+        uint64_t depth = base > frame ? static_cast<uint64_t>(base - frame) : 0ULL;
+
+        m_recorder->begin_scope(label);
+        stack_usage_t& su = m_recorder->cnt();
+        if (depth > su.max_depth) {
+            su.max_depth = depth;
+        }
+    }
+
+    /** Destructor will close the scope for the currently active label. */
+    ~measure_stack_t() {
+        m_recorder->end_scope();
+    }
+private:
+    /** Pointer to the recorder. */
+    recorder_type * m_recorder;
+};
+
+/** @brief Writes the stack depth flamegraph in the collapsed stack format.
+ *
+ *  The value of each node is its maximum depth minus the maximum depth
+ *  of its parent, so the values along a path add up to the deepest stack
+ *  seen when the last scope of the path was opened.
+ *
+ *  @param recorder Recorder holding the stack usage
+ *  @param os       Output stream where to write the result
+ *  @param l_out    Function used to output the label type to output stream
+ */
+template<typename LabelType>
+void to_stack_collapsed_stacks(
+    recorder_t<LabelType, stack_usage_t>& recorder,
+    std::ostream& os,
+    const std::function<void(std::ostream& os, const LabelType& l)> & l_out)
+{
+    std::vector<uint64_t> depths;
+    recorder.for_each_path([&] (const std::vector<LabelType>& path, const stack_usage_t& value) {
+        depths.resize(path.size());
+        uint64_t parent_depth = path.size() > 1 ? depths[path.size() - 2] : 0ULL;
+        depths[path.size() - 1] = std::max(value.max_depth, parent_depth);
+
+        for (size_t i { 0U }; i < path.size(); i++) {
+            if (i > 0) {
+                os << ";";
+            }
+            l_out(os, path[i]);
+        }
+        os << " " << depths[path.size() - 1] - parent_depth << "\n";
+    });
+}
+
+/** @brief Writes the path with the deepest stack, in the format
+ *         "depth label;label;label".
+ *
+ *  @param recorder Recorder holding the stack usage
+ *  @param os       Output stream where to write the result
+ *  @param l_out    Function used to output the label type to output stream
+ *  @return The deepest stack in bytes
+ */
+template<typename LabelType>
+uint64_t to_worst_stack_path(
+    recorder_t<LabelType, stack_usage_t>& recorder,
+    std::ostream& os,
+    const std::function<void(std::ostream& os, const LabelType& l)> & l_out)
+{
+    /* First pass finds the depth, the second one prints the path */
+    uint64_t worst = 0ULL;
+    recorder.for_each_path([&] (const std::vector<LabelType>&, const stack_usage_t& value) {
+        worst = std::max(worst, value.max_depth);
+    });
+
+    bool printed = false;
+    recorder.for_each_path([&] (const std::vector<LabelType>& path, const stack_usage_t& value) {
+        if (printed || value.max_depth != worst) {
+            return;
+        }
+
+        os << worst << " ";
+        for (size_t i { 0U }; i < path.size(); i++) {
+            if (i > 0) {
+                os << ";";
+            }
+            l_out(os, path[i]);
+        }
+        os << "\n";
+        printed = true;
+    });
+
+    return worst;
+}
+
+}
@@ -0,0 +1,132 @@
+#include <atomic>
+#include <fstream>
+#include <cstdlib>
+#include <time.h>
+#include <dlfcn.h>
+#include <cxxabi.h>
+
+#include "fiya-startup.h"
+
+/** Number of nodes of the startup profile, 48 bytes each */
+#ifndef FIYA_STARTUP_NODES
+#define FIYA_STARTUP_NODES (1U << 16)
+#endif
+
+/** The startup profile. Constant initialized, so it is ready before
+ *  the first static constructor runs.
+ */
+static fiya::startup_profile_t<FIYA_STARTUP_NODES> startup_profile;
+
+/** Set by the first thread that enters an instrumented function;
+ *  only that thread, normally the main thread, is recorded.
+ */
+static std::atomic<bool> startup_thread_claimed { false };
+
+/** Role of the current thread: 0 undecided, 1 recorded, 2 not recorded.
+ *  Constant initialized, so it can be used before main.
+ */
+static thread_local int startup_thread_role = 0;
+
+/** Set while the hooks are running, to avoid recursive calls of the
+ *  hooks from functions they call.
+ */
+static thread_local bool startup_hook_running = false;
+
+static uint64_t startup_now_ns() __attribute__((no_instrument_function));
+static bool startup_enter_hook() __attribute__((no_instrument_function));
+
+static uint64_t startup_now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+/** @brief Returns true if the current thread is recorded and not already in
+ *         a hook, and marks the hook as running. The caller resets
+ *         startup_hook_running when done.
+ */
+static bool startup_enter_hook() {
+    if (startup_hook_running) {
+        return false;
+    }
+    startup_hook_running = true;
+
+    if (startup_thread_role == 0) {
+        bool expected = false;
+        startup_thread_role = startup_thread_claimed.compare_exchange_strong(expected, true) ? 1 : 2;
+    }
+    if (startup_thread_role != 1) {
+        startup_hook_running = false;
+        return false;
+    }
+    return true;
+}
+
+extern "C" {
+
+void __cyg_profile_func_enter (void *, void *) __attribute__((no_instrument_function));
+void __cyg_profile_func_exit (void *, void *) __attribute__((no_instrument_function));
+
+void __cyg_profile_func_enter(void *this_fn, void *) {
+    if (startup_enter_hook()) {
+        startup_profile.enter(this_fn, startup_now_ns());
+        startup_hook_running = false;
+    }
+}
+
+void __cyg_profile_func_exit(void *, void *) {
+    if (startup_enter_hook()) {
+        startup_profile.exit(startup_now_ns());
+        startup_hook_running = false;
+    }
+}
+
+}
+
+namespace fiya {
+
+void startup_main() {
+    if (startup_enter_hook()) {
+        startup_profile.set_phase(startup_phase_t::main_init, startup_now_ns());
+        startup_hook_running = false;
+    }
+}
+
+void startup_dump(std::ostream& os) {
+    bool was_running = startup_hook_running;
+    startup_hook_running = true;
+
+    startup_profile.to_collapsed_stacks(os, [] (std::ostream& os, void* const & l) {
+        Dl_info info;
+        int status;
+        /* Looking up the function name instead of the address */
+        if (dladdr(l, &info) && info.dli_sname) {
+            char * demangled_name = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+            if (demangled_name) {
+                os << demangled_name;
+                free(demangled_name);
+            } else {
+                os << info.dli_sname;
+            }
+        } else {
+            os << l;
+        }
+    });
+
+    startup_hook_running = was_running;
+}
+
+void startup_ready(const char * file_name) {
+    if (startup_enter_hook()) {
+        startup_profile.set_phase(startup_phase_t::steady, startup_now_ns());
+        startup_hook_running = false;
+    }
+
+    if (file_name == nullptr) {
+        file_name = getenv("FIYA_STARTUP_OUT");
+    }
+    std::ofstream file(file_name ? file_name : "fiya-startup.txt");
+    startup_dump(file);
+}
+
+}
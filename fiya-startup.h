@@ -0,0 +1,213 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <ostream>
+#include <functional>
+
+namespace fiya {
+
+/** Phases of the program's startup */
+enum class startup_phase_t : uint32_t {
+    /** Static constructors and library initialization, before main */
+    pre_main = 0,
+    /** From startup_main() until startup_ready() */
+    main_init = 1,
+    /** After startup_ready() */
+    steady = 2
+};
+
+/** Number of startup phases */
+constexpr size_t startup_phase_count { 3U };
+
+/** Returns the name of the phase, used as the first frame of the stacks */
+inline const char * startup_phase_name(startup_phase_t phase) {
+    static const char * names[] = { "pre-main", "main-init", "steady" };
+    return names[static_cast<uint32_t>(phase)];
+}
+
+/** Node of startup_profile_t */
+struct startup_node_t {
+    /** Address of the function */
+    void * fn;
+    /** Index of the parent, the child list and the next sibling, 0 is none */
+    uint32_t parent;
+    uint32_t first_child;
+    uint32_t next_sibling;
+    /** Self wall time in nanoseconds in each phase */
+    uint64_t ns[startup_phase_count];
+};
+
+/** @brief Call tree of the startup, in fixed storage of N nodes.
+ *
+ *  The constructor is constexpr, so a global instance is constant
+ *  initialized: it is usable from the first instrumented function, before
+ *  any dynamic initialization has run, and it never allocates while
+ *  recording. Scopes that don't fit are accounted to their parent.
+ *  Node 0 is the root.
+ *
+ *  The instance used by the -finstrument-functions hooks lives in
+ *  fiya-startup-overloads.cpp.
+ */
+template <size_t N>
+class startup_profile_t {
+public:
+    constexpr startup_profile_t() :
+        m_nodes{},
+        m_size(1U),
+        m_current(0U),
+        m_phase(startup_phase_t::pre_main),
+        m_last_ns(0U),
+        m_overflow_depth(0U),
+        m_dropped(0U)
+    { }
+
+    /** Enters the function @fn at the time @now_ns */
+    void enter(void * fn, uint64_t now_ns) {
+        account(now_ns);
+
+        if (m_overflow_depth > 0) {
+            m_overflow_depth++;
+            return;
+        }
+
+        uint32_t child = find_or_create_child(m_current, fn);
+        if (child == 0) {
+            m_overflow_depth++;
+            m_dropped++;
+            return;
+        }
+        m_current = child;
+    }
+
+    /** Leaves the current function at the time @now_ns */
+    void exit(uint64_t now_ns) {
+        account(now_ns);
+
+        if (m_overflow_depth > 0) {
+            m_overflow_depth--;
+        } else if (m_current != 0) {
+            m_current = m_nodes[m_current].parent;
+        }
+    }
+
+    /** Starts the phase @phase at the time @now_ns */
+    void set_phase(startup_phase_t phase, uint64_t now_ns) {
+        account(now_ns);
+        m_phase = phase;
+    }
+
+    /** Returns the current phase */
+    startup_phase_t phase() const {
+        return m_phase;
+    }
+
+    /** Returns the number of scopes that didn't fit into the storage */
+    uint64_t dropped() const {
+        return m_dropped;
+    }
+
+    /** Returns the number of used nodes */
+    size_t size() const {
+        return m_size;
+    }
+
+    /** @brief Writes the profile in the collapsed stack format, with the
+     *         phase as the first frame and the self time in microseconds.
+     *         Not to be called concurrently with recording.
+     */
+    void to_collapsed_stacks(std::ostream& os, const std::function<void(std::ostream& os, void* const & l)> & l_out) const {
+        std::vector<uint32_t> path;
+        for (size_t phase { 0U }; phase < startup_phase_count; phase++) {
+            for (uint32_t node { 1U }; node < m_size; node++) {
+                if (m_nodes[node].ns[phase] == 0) {
+                    continue;
+                }
+
+                path.clear();
+                for (uint32_t n { node }; n != 0; n = m_nodes[n].parent) {
+                    path.push_back(n);
+                }
+
+                os << startup_phase_name(static_cast<startup_phase_t>(phase));
+                for (size_t i { path.size() }; i > 0; i--) {
+                    os << ";";
+                    l_out(os, m_nodes[path[i - 1]].fn);
+                }
+                os << " " << (m_nodes[node].ns[phase] + 500) / 1000 << "\n";
+            }
+        }
+    }
+private:
+    startup_node_t m_nodes[N];
+    /** Number of used nodes */
+    uint32_t m_size;
+    /** Node of the running function */
+    uint32_t m_current;
+    /** Current phase */
+    startup_phase_t m_phase;
+    /** Time of the last transition */
+    uint64_t m_last_ns;
+    /** Depth of the functions entered after the storage was full */
+    uint64_t m_overflow_depth;
+    /** Number of functions that didn't fit into the storage */
+    uint64_t m_dropped;
+
+    /** Adds the time since the last transition to the running function */
+    void account(uint64_t now_ns) {
+        if (m_last_ns != 0) {
+            m_nodes[m_current].ns[static_cast<uint32_t>(m_phase)] += now_ns - m_last_ns;
+        }
+        m_last_ns = now_ns;
+    }
+
+    /** @brief Returns the child of @node for @fn, creating it if needed,
+     *         or 0 if the storage is full. A found child is moved to the
+     *         front of the list, since the same call usually repeats.
+     */
+    uint32_t find_or_create_child(uint32_t node, void * fn) {
+        uint32_t previous { 0U };
+        for (uint32_t child { m_nodes[node].first_child }; child != 0; child = m_nodes[child].next_sibling) {
+            if (m_nodes[child].fn == fn) {
+                if (previous != 0) {
+                    m_nodes[previous].next_sibling = m_nodes[child].next_sibling;
+                    m_nodes[child].next_sibling = m_nodes[node].first_child;
+                    m_nodes[node].first_child = child;
+                }
+                return child;
+            }
+            previous = child;
+        }
+
+        if (m_size == N) {
+            return 0;
+        }
+
+        uint32_t child { m_size++ };
+        m_nodes[child].fn = fn;
+        m_nodes[child].parent = node;
+        m_nodes[child].next_sibling = m_nodes[node].first_child;
+        m_nodes[node].first_child = child;
+        return child;
+    }
+};
+
+/** @brief Marks the start of main. Call it first thing in main; the time
+ *         before is accounted to the pre-main phase. Defined in
+ *         fiya-startup-overloads.cpp.
+ */
+void startup_main();
+
+/** @brief Marks the program as ready: starts the steady phase and writes
+ *         the startup profile to @file_name, or if it is nullptr, to the file
+ *         given by the environment variable FIYA_STARTUP_OUT, by default
+ *         fiya-startup.txt. Defined in fiya-startup-overloads.cpp.
+ */
+void startup_ready(const char * file_name = nullptr);
+
+/** @brief Writes the profile recorded so far in the collapsed stack format.
+ *         Call it from the recording thread. Defined in fiya-startup-overloads.cpp.
+ */
+void startup_dump(std::ostream& os);
+
+}
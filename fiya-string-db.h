@@ -2,7 +2,9 @@
 #pragma once
 
 #include <unordered_set>
+#include <new>
 #include <cstddef>
+#include <cstdlib>
 #include <cstring>
 #include <cassert>
 
@@ -70,16 +72,12 @@ public:
                  * we need to regrow the m_data to store it.
                  */
                 size_t new_capacity = std::max<size_t>(m_capacity * 1.5, string_len + m_size);
+                /* realloc copies the data and frees the old block if it moves it */
                 char* new_data = reinterpret_cast<char*>(realloc(m_data, new_capacity * sizeof(char)));
                 if (new_data == nullptr) {
                     throw std::bad_alloc();
                 }
 
-                if (new_data != m_data) {
-                    std::memcpy(new_data, m_data, m_size * sizeof(char));    
-                    free(m_data);
-                }
-
                 m_data = new_data;
                 m_capacity = new_capacity;
             }
@@ -0,0 +1,269 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <vector>
+#include <ostream>
+#include <functional>
+#include <type_traits>
+#include <unordered_map>
+
+#include "fiya-time-measure.h"
+
+namespace fiya {
+
+/** Identifier of a tag, e.g. a tenant or a request type */
+using tag_id_t = size_t;
+
+/** Tag of the scopes recorded before any tag is set */
+constexpr tag_id_t untagged_tag { 0U };
+
+/** Tag used for all tags registered after the cardinality limit is reached */
+constexpr tag_id_t overflow_tag { 1U };
+
+/** @brief Registry of tag names. Interns each name to a small id, up to a
+ *         cardinality limit; names registered after the limit all get
+ *         overflow_tag, so an unbounded dimension (e.g. user ids) can't
+ *         multiply the recorded trees without bound.
+ *
+ *  The registry is thread-safe. Registering takes a lock, so look the ids
+ *  up once and keep them, or at most once per request.
+ */
+class tag_registry_t {
+public:
+    /** Constructor
+     *
+     *    @param max_tags      Maximum number of registered tags, not counting
+     *                         untagged_tag and overflow_tag
+     *    @param overflow_name Name of overflow_tag
+     */
+    tag_registry_t(size_t max_tags = 64, const char * overflow_name = "other") :
+        m_max_tags(max_tags)
+    {
+        m_names.push_back("untagged");
+        m_names.push_back(overflow_name);
+    }
+
+    /** @brief Returns the id of the tag @name, registering it if needed.
+     *         Returns overflow_tag if the registry is full.
+     */
+    tag_id_t register_tag(const char * name) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_ids.find(name);
+        if (it != m_ids.end()) {
+            return it->second;
+        }
+
+        if (m_names.size() - 2 == m_max_tags) {
+            return overflow_tag;
+        }
+
+        m_names.push_back(name);
+        m_ids.insert(std::make_pair(m_names.back(), m_names.size() - 1));
+        return m_names.size() - 1;
+    }
+
+    /** Returns the name of the tag @id */
+    std::string name(tag_id_t id) const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_names[id];
+    }
+
+    /** Returns the number of tags, including untagged_tag and overflow_tag */
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_names.size();
+    }
+
+    /** Returns the largest number of tags the registry can hold */
+    size_t capacity() const {
+        return m_max_tags + 2;
+    }
+private:
+    /** Maximum number of registered tags */
+    size_t m_max_tags;
+    /** Protects the members below */
+    mutable std::mutex m_mutex;
+    /** Tag names, indexed by tag_id_t */
+    std::deque<std::string> m_names;
+    /** Tag id of each name */
+    std::unordered_map<std::string, tag_id_t> m_ids;
+};
+
+/** @brief A recorder per tag. The thread sets the current tag at request
+ *         boundaries, and the scopes are recorded into the current tag's
+ *         tree, so the labels stay the same and each tree only has the
+ *         nodes seen with its tag.
+ *
+ *  Like recorder_t, it is not thread-safe: use one per thread, as the
+ *  thread's recorder, and merge them for the export.
+ *
+ *  @code
+ *  thread_local tagged_recorder_t<const char*, time_value_t> recorders(&tags, {}, "root", time_value_t::now());
+ *
+ *  void handle(const request_t& r) {
+ *      tag_scope_t<const char*, time_value_t> tag(&recorders, r.tenant_tag);
+ *      measure_time_t<const char*> m("handle", recorders.recorder());
+ *      ...
+ *  }
+ *  @endcode
+ */
+template <typename LabelType, typename MeasureType>
+class tagged_recorder_t {
+public:
+    using recorder_type = recorder_t<LabelType, MeasureType>;
+
+    /** Constructor
+     *
+     *    @param registry      Registry of the tags
+     *    @param default_value Measure value used to initialize new nodes
+     *    @param root_label    Label of the root of each tag's tree
+     *    @param root_value    Measure value of the root of each tag's tree
+     */
+    tagged_recorder_t(const tag_registry_t * registry, MeasureType default_value, const LabelType& root_label, MeasureType root_value) :
+        m_registry(registry),
+        m_default_value(default_value),
+        m_root_label(root_label),
+        m_root_value(root_value),
+        m_recorders(registry->capacity()),
+        m_current_tag(untagged_tag),
+        m_current(get_or_create(untagged_tag))
+    { }
+
+    /** @brief Makes @tag the current tag. Scopes opened from now on are
+     *         recorded in its tree; scopes already open are closed in the
+     *         tree they were opened in. If the measure type is a time value,
+     *         the running time is handed over to the new tree.
+     */
+    void set_tag(tag_id_t tag) {
+        if (tag == m_current_tag) {
+            return;
+        }
+        recorder_type * next = get_or_create(tag);
+        if constexpr (std::is_base_of<time_value_t, MeasureType>::value) {
+            time_value_t::handoff(m_current->cnt(), next->cnt());
+        }
+        m_current = next;
+        m_current_tag = tag;
+    }
+
+    /** Returns the current tag */
+    tag_id_t tag() const {
+        return m_current_tag;
+    }
+
+    /** Returns the recorder of the current tag */
+    recorder_type * recorder() {
+        return m_current;
+    }
+
+    /** Returns the recorder of @tag, or nullptr if nothing was recorded with it */
+    recorder_type * recorder(tag_id_t tag) {
+        return m_recorders[tag].get();
+    }
+
+    /** @brief Calls @visitor for each tag that has a tree, in tag id order. */
+    void for_each_tag(const std::function<void(tag_id_t tag, const std::string& name, recorder_type& recorder)>& visitor) {
+        for (tag_id_t tag { 0U }; tag < m_recorders.size(); tag++) {
+            if (m_recorders[tag]) {
+                visitor(tag, m_registry->name(tag), *m_recorders[tag]);
+            }
+        }
+    }
+
+    /** @brief Adds the trees of @other, e.g. of another thread, tag by tag. */
+    void merge(tagged_recorder_t& other) {
+        for (tag_id_t tag { 0U }; tag < other.m_recorders.size(); tag++) {
+            if (other.m_recorders[tag]) {
+                get_or_create(tag)->merge(*other.m_recorders[tag]);
+            }
+        }
+    }
+
+    /** @brief Writes the flamegraph of one tag in the collapsed stack format.
+     *         Writes nothing if the tag has no tree.
+     */
+    void to_collapsed_stacks(
+        tag_id_t tag,
+        std::ostream& os,
+        const std::function<void(std::ostream& os, const LabelType& l)> & l_out,
+        const std::function<void(std::ostream& os, const MeasureType& m)> & m_out)
+    {
+        if (m_recorders[tag]) {
+            m_recorders[tag]->to_collapsed_stacks(os, l_out, m_out);
+        }
+    }
+
+    /** @brief Writes the combined flamegraph of all tags in the collapsed
+     *         stack format. Each stack starts with a synthetic frame with
+     *         the tag name, so the tags are the first level of the graph.
+     */
+    void to_collapsed_stacks(
+        std::ostream& os,
+        const std::function<void(std::ostream& os, const LabelType& l)> & l_out,
+        const std::function<void(std::ostream& os, const MeasureType& m)> & m_out)
+    {
+        for_each_tag([&] (tag_id_t, const std::string& name, recorder_type& recorder) {
+            recorder.for_each_path([&] (const std::vector<LabelType>& path, const MeasureType& value) {
+                os << name;
+                for (const LabelType& l: path) {
+                    os << ";";
+                    l_out(os, l);
+                }
+                os << " ";
+                m_out(os, value);
+                os << "\n";
+            });
+        });
+    }
+private:
+    /** Registry of the tags */
+    const tag_registry_t * m_registry;
+    /** Measure value used to initialize new nodes */
+    MeasureType m_default_value;
+    /** Label of the root of each tag's tree */
+    LabelType m_root_label;
+    /** Measure value of the root of each new tree */
+    MeasureType m_root_value;
+    /** Recorder of each tag, created when the tag is first set */
+    std::vector<std::unique_ptr<recorder_type>> m_recorders;
+    /** Current tag */
+    tag_id_t m_current_tag;
+    /** Recorder of the current tag */
+    recorder_type * m_current;
+
+    recorder_type * get_or_create(tag_id_t tag) {
+        if (!m_recorders[tag]) {
+            m_recorders[tag].reset(new recorder_type(m_default_value, m_root_label, m_root_value));
+        }
+        return m_recorders[tag].get();
+    }
+};
+
+/** @brief RAII wrapper setting the current tag of a tagged_recorder_t,
+ *         e.g. for the duration of a request. The destructor restores
+ *         the previous tag.
+ */
+template <typename LabelType, typename MeasureType>
+class tag_scope_t {
+public:
+    tag_scope_t(tagged_recorder_t<LabelType, MeasureType> * recorder, tag_id_t tag) :
+        m_recorder(recorder),
+        m_previous_tag(recorder->tag())
+    {
+        m_recorder->set_tag(tag);
+    }
+
+    ~tag_scope_t() {
+        m_recorder->set_tag(m_previous_tag);
+    }
+private:
+    /** Tagged recorder whose tag is set */
+    tagged_recorder_t<LabelType, MeasureType> * m_recorder;
+    /** Tag restored by the destructor */
+    tag_id_t m_previous_tag;
+};
+
+}
@@ -0,0 +1,255 @@
+#pragma once
+
+#include <mutex>
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <vector>
+#include <ostream>
+#include <algorithm>
+#include <functional>
+
+#include "fiya-time-measure.h"
+
+namespace fiya {
+
+/** Options of tail_capture_t */
+struct tail_options_t {
+    /** Requests that take at least this long (wall clock) are slow */
+    std::chrono::steady_clock::duration threshold = std::chrono::milliseconds(100);
+    /** Number of slowest requests whose trees are kept verbatim */
+    size_t keep_slowest = 10;
+    /** If true, the requests under the threshold are merged into an aggregate
+     *  too, to compare the slow requests with the normal ones. This costs a
+     *  merge per request.
+     */
+    bool aggregate_fast = false;
+};
+
+/** @brief Tail latency capture: every request is recorded into a scratch
+ *         recorder taken from a pool, and the recorder is kept only if the
+ *         request turns out to be slow.
+ *
+ *  A fast request's recorder is reset and returned to the pool. Because reset
+ *  keeps the nodes, requests that take the usual paths don't allocate. Slow
+ *  requests are merged into the "slow requests" aggregate, and the trees of
+ *  the keep_slowest slowest requests are kept as they were recorded.
+ *
+ *  The class is thread-safe, each thread records its requests into its own
+ *  scratch recorder. Use it through tail_request_t.
+ */
+template <typename LabelType, typename MeasureType = time_value_t>
+class tail_capture_t {
+public:
+    using recorder_type = recorder_t<LabelType, MeasureType>;
+
+    /** A slow request kept verbatim */
+    struct slow_request_t {
+        std::chrono::steady_clock::duration latency;
+        std::unique_ptr<recorder_type> recorder;
+    };
+
+    /** Constructor
+     *
+     *    @param root_label Label of the root of all trees
+     *    @param options    Threshold and number of kept requests
+     */
+    tail_capture_t(const LabelType& root_label, const tail_options_t& options = tail_options_t()) :
+        m_root_label(root_label),
+        m_options(options),
+        m_slow(MeasureType{}, root_label, MeasureType{}),
+        m_fast(MeasureType{}, root_label, MeasureType{})
+    { }
+
+    /** @brief Returns a recorder for a new request, from the pool if possible.
+     *         The value of the root is MeasureType::now().
+     */
+    std::unique_ptr<recorder_type> acquire() {
+        std::unique_ptr<recorder_type> result;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_pool.empty()) {
+                result = std::move(m_pool.back());
+                m_pool.pop_back();
+            }
+        }
+
+        if (result) {
+            result->reset(MeasureType::now());
+        } else {
+            result.reset(new recorder_type(MeasureType{}, m_root_label, MeasureType::now()));
+        }
+        return result;
+    }
+
+    /** @brief Ends the request recorded in @recorder, which took @latency.
+     *         All scopes of the request need to be closed. The merge into
+     *         an aggregate runs under the aggregate's own lock, so it doesn't
+     *         hold up acquire() and the requests that are not merged.
+     */
+    void release(std::unique_ptr<recorder_type> recorder, std::chrono::steady_clock::duration latency) {
+        bool slow = latency >= m_options.threshold;
+        if (slow) {
+            std::lock_guard<std::mutex> lock(m_slow_mutex);
+            m_slow.merge(*recorder);
+        } else if (m_options.aggregate_fast) {
+            std::lock_guard<std::mutex> lock(m_fast_mutex);
+            m_fast.merge(*recorder);
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_requests++;
+
+        if (!slow) {
+            m_pool.push_back(std::move(recorder));
+            return;
+        }
+
+        m_slow_requests++;
+
+        if (m_options.keep_slowest == 0) {
+            m_pool.push_back(std::move(recorder));
+            return;
+        }
+
+        /* m_slowest is a min-heap on latency, the fastest of the kept requests is on top */
+        auto faster = [] (const slow_request_t& r1, const slow_request_t& r2) {
+            return r1.latency > r2.latency;
+        };
+
+        if (m_slowest.size() < m_options.keep_slowest) {
+            m_slowest.push_back(slow_request_t{ latency, std::move(recorder) });
+            std::push_heap(m_slowest.begin(), m_slowest.end(), faster);
+        } else if (latency > m_slowest.front().latency) {
+            std::pop_heap(m_slowest.begin(), m_slowest.end(), faster);
+            m_pool.push_back(std::move(m_slowest.back().recorder));
+            m_slowest.back() = slow_request_t{ latency, std::move(recorder) };
+            std::push_heap(m_slowest.begin(), m_slowest.end(), faster);
+        } else {
+            m_pool.push_back(std::move(recorder));
+        }
+    }
+
+    /** Returns the number of recorded requests */
+    size_t requests() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_requests;
+    }
+
+    /** Returns the number of requests at or above the threshold */
+    size_t slow_requests() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_slow_requests;
+    }
+
+    /** @brief Returns the aggregate of all slow requests.
+     *  @note Not synchronized with requests ending in other threads.
+     */
+    recorder_type& slow_aggregate() {
+        return m_slow;
+    }
+
+    /** @brief Returns the aggregate of the requests under the threshold,
+     *         empty unless tail_options_t::aggregate_fast is set.
+     *  @note Not synchronized with requests ending in other threads.
+     */
+    recorder_type& fast_aggregate() {
+        return m_fast;
+    }
+
+    /** @brief Calls @visitor for each kept slow request, slowest first.
+     *  @note Not synchronized with requests ending in other threads.
+     */
+    void for_each_slowest(const std::function<void(std::chrono::steady_clock::duration latency, recorder_type& recorder)>& visitor) {
+        std::vector<slow_request_t*> sorted;
+        for (slow_request_t& r: m_slowest) {
+            sorted.push_back(&r);
+        }
+        std::sort(sorted.begin(), sorted.end(), [] (const slow_request_t* r1, const slow_request_t* r2) {
+            return r1->latency > r2->latency;
+        });
+
+        for (slow_request_t* r: sorted) {
+            visitor(r->latency, *r->recorder);
+        }
+    }
+private:
+    /** Label of the root of all trees */
+    LabelType m_root_label;
+    /** Threshold and number of kept requests */
+    tail_options_t m_options;
+    /** Protect the aggregates while requests are merged into them */
+    std::mutex m_slow_mutex;
+    std::mutex m_fast_mutex;
+    /** Aggregate of the slow requests */
+    recorder_type m_slow;
+    /** Aggregate of the fast requests, if enabled */
+    recorder_type m_fast;
+    /** Protects all members below */
+    mutable std::mutex m_mutex;
+    /** Recorders ready for reuse */
+    std::vector<std::unique_ptr<recorder_type>> m_pool;
+    /** The slowest requests, a heap with the fastest of them on top */
+    std::vector<slow_request_t> m_slowest;
+    /** Number of recorded requests */
+    size_t m_requests = 0;
+    /** Number of slow requests */
+    size_t m_slow_requests = 0;
+};
+
+/** @brief RAII wrapper for one request of tail_capture_t. The constructor
+ *         takes a scratch recorder and opens the scope @label in it; the
+ *         destructor closes it and hands the recorder back with the request's
+ *         wall clock latency.
+ *
+ *  @code
+ *  thread_local measure_time_t<const char*>::recorder_type* request_recorder;
+ *
+ *  void handle(const request_t& r) {
+ *      tail_request_t<const char*> request("handle", &capture);
+ *      request_recorder = request.recorder();
+ *      ...
+ *  }
+ *  @endcode
+ */
+template <typename LabelType, typename MeasureType = time_value_t>
+class tail_request_t {
+public:
+    using capture_type = tail_capture_t<LabelType, MeasureType>;
+    using recorder_type = typename capture_type::recorder_type;
+
+    tail_request_t(const LabelType& label, capture_type * capture) :
+        m_capture(capture),
+        m_start(std::chrono::steady_clock::now()),
+        m_recorder(capture->acquire())
+    {
+        m_measure.emplace(label, m_recorder.get());
+    }
+
+    ~tail_request_t() {
+        m_measure.reset();
+        try {
+            m_capture->release(std::move(m_recorder), std::chrono::steady_clock::now() - m_start);
+        } catch (...) {
+            /* Out of memory while merging: the request is lost, but a destructor must not throw */
+        }
+    }
+
+    /** Returns the recorder of this request. Scopes opened in it need to be
+     *  closed before the request ends.
+     */
+    recorder_type * recorder() {
+        return m_recorder.get();
+    }
+private:
+    /** Capture the request belongs to */
+    capture_type * m_capture;
+    /** Wall clock time when the request started */
+    std::chrono::steady_clock::time_point m_start;
+    /** Scratch recorder of the request */
+    std::unique_ptr<recorder_type> m_recorder;
+    /** Scope of the whole request, closed before the recorder is handed back */
+    std::optional<measure_time_t<LabelType, MeasureType>> m_measure;
+};
+
+}
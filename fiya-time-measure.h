@@ -3,6 +3,7 @@
 #include <chrono>
 #include <functional>
 
+#include "fiya-level.h"
 #include "fiya-recorder.h"
 
 #if defined (__unix__) || (defined (__APPLE__) && defined (__MACH__))
@@ -62,6 +63,11 @@ std::chrono::time_point<std::chrono::high_resolution_clock> get_thread_time() {
 #error Missing get_thread_time() function for this platform
 #endif
 
+class time_value_t;
+
+template <typename LabelType, typename MeasureType = time_value_t, typename RecorderType = recorder_t<LabelType, MeasureType>>
+class measure_time_t;
+
 class time_value_t {
 public:
     time_value_t() = default;
@@ -87,40 +93,79 @@ public:
         result.m_duration = m_duration + other.m_duration;
         return result;
     }
+
+    /** @brief Moves the running clock from @from to @to: the time since the
+     *         last scope transition is added to @from and @to starts counting
+     *         now. Used when the thread switches to another recorder.
+     */
+    static void handoff(time_value_t& from, time_value_t& to) {
+        auto now = get_thread_time<void>();
+        from.m_duration += now - from.m_start;
+        to.m_start = now;
+    }
 private:
     std::chrono::high_resolution_clock::duration m_duration;
     
     std::chrono::time_point<std::chrono::high_resolution_clock> m_start;
 
-    template<typename T>
+    template<typename T, typename M, typename R>
     friend class measure_time_t;
     
     template<typename T>
     friend class cyg_measure_time_t;
+
+    template<typename T>
+    friend class bench_t;
+
+    template<typename T>
+    friend class sampled_measure_time_t;
 };
 
-template <typename LabelType>
+/** RAII wrapper for measuring time. The MeasureType can be
+ *  time_value_t or a type derived from it that carries additional
+ *  values, e.g. counted_time_value_t from fiya-counters.h. The
+ *  RecorderType can be any type with recorder_t's begin_scope,
+ *  end_scope and cnt(), e.g. window_recorder_t from fiya-window.h.
+ */
+template <typename LabelType, typename MeasureType, typename RecorderType>
 class measure_time_t {
 public:
-    using measure_type = time_value_t;
-    using recorder_type = recorder_t<LabelType, measure_type>;
-
-    measure_time_t(const LabelType& label, recorder_type * recorder):
-        m_recorder(recorder)
+    using measure_type = MeasureType;
+    using recorder_type = RecorderType;
+
+    /** Opens the scope, unless recording is disabled or @level is finer
+     *  than the active level (see fiya-level.h). A skipped scope reads
+     *  no clock and its time is accounted to the enclosing scope.
+     */
+    measure_time_t(const LabelType& label, recorder_type * recorder, level_t level = level_t::normal):
+        m_recorder(is_level_active(level) ? recorder : nullptr)
     {
+        if (m_recorder == nullptr) {
+            return;
+        }
         m_recorder->cnt().m_duration += get_thread_time<void>() - m_recorder->cnt().m_start;
-        m_recorder->begin_scope(label);
+        try {
+            m_recorder->begin_scope(label);
+        } catch (...) {
+            /* The destructor won't run: the parent counts again from now,
+               its time until now is already added */
+            m_recorder->cnt().m_start = get_thread_time<void>();
+            throw;
+        }
         m_recorder->cnt().m_start = get_thread_time<void>();
-
     }
 
     ~measure_time_t() {
+        if (m_recorder == nullptr) {
+            return;
+        }
         m_recorder->cnt().m_duration += get_thread_time<void>() - m_recorder->cnt().m_start;
 
         m_recorder->end_scope();
         m_recorder->cnt().m_start = get_thread_time<void>();
     }
 private:
+    /** Pointer to the recorder, nullptr if the scope is not recorded */
     recorder_type * m_recorder;
 };
 
@@ -138,7 +183,12 @@ public:
 
     void begin_scope(const LabelType& label) override {
         m_recorder->cnt().m_duration += get_thread_time<void>() - m_recorder->cnt().m_start;
-        m_recorder->begin_scope(label);
+        try {
+            m_recorder->begin_scope(label);
+        } catch (...) {
+            m_recorder->cnt().m_start = get_thread_time<void>();
+            throw;
+        }
         m_recorder->cnt().m_start = get_thread_time<void>();
     }
     
@@ -0,0 +1,214 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <vector>
+#include <ostream>
+#include <algorithm>
+#include <functional>
+#include <type_traits>
+
+#include "fiya-time-measure.h"
+
+namespace fiya {
+
+/** @brief Value of a node of window_recorder_t: one measure value per
+ *         interval of the window.
+ */
+template <typename MeasureType, size_t K>
+struct window_value_t {
+    std::array<MeasureType, K> slots;
+
+    window_value_t operator+(const window_value_t& other) const {
+        window_value_t result;
+        for (size_t i { 0U }; i < K; i++) {
+            result.slots[i] = slots[i] + other.slots[i];
+        }
+        return result;
+    }
+};
+
+/** @brief Recorder keeping a sliding window of K intervals. All intervals
+ *         share one tree, i.e. the label store and the nodes, and each node
+ *         holds a ring of K values. Recording only indexes the value of the
+ *         current interval; advance() moves to the next interval and clears
+ *         the values of the oldest one.
+ *
+ *  The exports cover the last n intervals, summing the values of each node.
+ *  Like recorder_t, it is not thread-safe: advance() is called by the
+ *  recording thread, e.g. advance_if_due() after each request.
+ *
+ *  Use it with measure_time_t and measure_heap_t through their RecorderType
+ *  parameter:
+ *  @code
+ *  using my_window_t = window_recorder_t<const char*, time_value_t, 5>;
+ *  thread_local my_window_t recorder({}, "root", time_value_t::now(), std::chrono::minutes(1));
+ *  measure_time_t<const char*, time_value_t, my_window_t> m("handle", &recorder);
+ *  @endcode
+ */
+template <typename LabelType, typename MeasureType, size_t K>
+class window_recorder_t: public counter_interface_t<MeasureType>, public scoping_interface_t<LabelType> {
+public:
+    static_assert(K > 0, "The window needs at least one interval");
+
+    using value_type = window_value_t<MeasureType, K>;
+    using recorder_type = recorder_t<LabelType, value_type>;
+
+    /** Constructor
+     *
+     *    @param default_value Measure value used to initialize newly constructed nodes
+     *    @param root_label    Name of the root label
+     *    @param root_value    Measure value of the root label in the first interval
+     *    @param interval      Length of an interval for advance_if_due(), zero if
+     *                         the intervals are advanced explicitly
+     */
+    window_recorder_t(MeasureType default_value, const LabelType& root_label, MeasureType root_value,
+                      std::chrono::steady_clock::duration interval = std::chrono::steady_clock::duration::zero()) :
+        m_default_value(default_value),
+        m_recorder(filled(default_value), root_label, filled(default_value)),
+        m_slot(0U),
+        m_intervals(1U),
+        m_interval(interval),
+        m_interval_start(std::chrono::steady_clock::now())
+    {
+        m_recorder.cnt().slots[0] = root_value;
+    }
+
+    /** Begins a new scope with a given label */
+    void begin_scope(const LabelType& label) override {
+        m_recorder.begin_scope(label);
+    }
+
+    /** Ends a scope */
+    void end_scope() override {
+        m_recorder.end_scope();
+    }
+
+    /** Ends a scope, checking its label */
+    void end_scope(const LabelType& label) override {
+        m_recorder.end_scope(label);
+    }
+
+    /** Returns the counter of the current scope in the current interval */
+    const MeasureType& cnt() const override {
+        return m_recorder.cnt().slots[m_slot];
+    }
+
+    /** Returns the counter of the current scope in the current interval */
+    MeasureType& cnt() override {
+        return m_recorder.cnt().slots[m_slot];
+    }
+
+    /** Returns true if the recording APIs are running */
+    bool recorder_internal_running() const override {
+        return m_recorder.recorder_internal_running();
+    }
+
+    /** @brief Starts the next interval. Its values, the oldest in the ring,
+     *         are cleared. For time values, the running time of the current
+     *         scope is split between the two intervals.
+     */
+    void advance() {
+        step();
+        m_interval_start = std::chrono::steady_clock::now();
+    }
+
+    /** @brief Advances as many intervals as elapsed since the current one
+     *         started, according to the interval given to the constructor.
+     *         The intervals keep their length: a late call doesn't delay
+     *         the following intervals. Returns the number of advanced
+     *         intervals.
+     */
+    size_t advance_if_due() {
+        if (m_interval == std::chrono::steady_clock::duration::zero()) {
+            return 0;
+        }
+        auto elapsed = std::chrono::steady_clock::now() - m_interval_start;
+        size_t count = static_cast<size_t>(elapsed / m_interval);
+        for (size_t i { 0U }; i < std::min(count, K); i++) {
+            step();
+        }
+        m_interval_start += m_interval * count;
+        return count;
+    }
+
+    /** Returns the number of intervals with values, at most K */
+    size_t intervals() const {
+        return m_intervals;
+    }
+
+    /** @brief Calls @visitor for every node with the sum of its values in
+     *         the last @last_n intervals, the current one included.
+     */
+    void for_each_path(size_t last_n, const std::function<void(const std::vector<LabelType>& path, const MeasureType& value)>& visitor) {
+        m_recorder.for_each_path([&] (const std::vector<LabelType>& path, const value_type& value) {
+            visitor(path, sum(value, last_n));
+        });
+    }
+
+    /** @brief Writes the flamegraph of the last @last_n intervals, the current
+     *         one included, in the collapsed stack format.
+     */
+    void to_collapsed_stacks(
+        size_t last_n,
+        std::ostream& os,
+        const std::function<void(std::ostream& os, const LabelType& l)> & l_out,
+        const std::function<void(std::ostream& os, const MeasureType& m)> & m_out)
+    {
+        m_recorder.to_collapsed_stacks(os, l_out, [&] (std::ostream& os, const value_type& value) {
+            m_out(os, sum(value, last_n));
+        });
+    }
+
+    /** Returns the underlying recorder with the values of all intervals */
+    recorder_type& recorder() {
+        return m_recorder;
+    }
+private:
+    /** Starts the next interval, see advance() */
+    void step() {
+        size_t next = (m_slot + 1) % K;
+        m_recorder.for_each_value([this, next] (value_type& value) {
+            value.slots[next] = m_default_value;
+        });
+
+        if constexpr (std::is_base_of<time_value_t, MeasureType>::value) {
+            value_type& current = m_recorder.cnt();
+            time_value_t::handoff(current.slots[m_slot], current.slots[next]);
+        }
+
+        m_slot = next;
+        m_intervals = std::min(m_intervals + 1, K);
+    }
+
+    /** Value of new nodes, and of the intervals that are cleared */
+    MeasureType m_default_value;
+    /** Shared tree with the values of all intervals */
+    recorder_type m_recorder;
+    /** Index of the current interval in the ring */
+    size_t m_slot;
+    /** Number of intervals with values */
+    size_t m_intervals;
+    /** Length of an interval for advance_if_due() */
+    std::chrono::steady_clock::duration m_interval;
+    /** Start of the current interval */
+    std::chrono::steady_clock::time_point m_interval_start;
+
+    static value_type filled(const MeasureType& value) {
+        value_type result;
+        result.slots.fill(value);
+        return result;
+    }
+
+    /** Sums the values of the last @last_n intervals */
+    MeasureType sum(const value_type& value, size_t last_n) const {
+        last_n = std::max<size_t>(std::min(last_n, K), 1U);
+        MeasureType result = value.slots[m_slot];
+        for (size_t i { 1U }; i < last_n; i++) {
+            result = result + value.slots[(m_slot + K - i) % K];
+        }
+        return result;
+    }
+};
+
+}
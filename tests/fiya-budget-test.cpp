@@ -0,0 +1,79 @@
+#include "../fiya-budget.h"
+#include <cassert>
+#include <cstring>
+
+using namespace fiya;
+
+using my_recorder_t = recorder_t<const char*, sampled_time_value_t>;
+
+/** Uses @us microseconds of CPU time */
+void burn_cpu(int us) {
+    auto start = get_thread_time<void>();
+    while (get_thread_time<void>() - start < std::chrono::microseconds(us)) {
+    }
+}
+
+/** Sums the calls of the scopes labeled @label */
+uint64_t calls_of(my_recorder_t& recorder, const char * label) {
+    uint64_t calls = 0;
+    recorder.for_each_path([&] (const std::vector<const char*>& path, const sampled_time_value_t& value) {
+        if (strcmp(path.back(), label) == 0) {
+            calls += value.calls;
+        }
+    });
+    return calls;
+}
+
+int main() {
+    my_recorder_t recorder({}, "root", sampled_time_value_t::now());
+    /* A recorded scope costs 100 us, so each sample is far over the budget */
+    budget_options_t options;
+    options.budget = 0.02;
+    options.window = std::chrono::milliseconds(2);
+    options.max_period = 1000;
+    budget_controller_t controller(overhead_cost_t{ 100000, 0.0 }, options);
+
+    const char * fine = "fine";
+    const char * normal = "normal";
+    budget_scope_t fine_scope(fine, 1, level_t::fine);
+    budget_scope_t normal_scope(normal, 1, level_t::normal);
+
+    auto run = [&] (int calls) {
+        for (int i = 0; i < calls; i++) {
+            budget_measure_time_t<const char*> m1(fine, &recorder, fine_scope, &controller);
+            budget_measure_time_t<const char*> m2(normal, &recorder, normal_scope, &controller);
+        }
+        burn_cpu(3000);
+        controller.check();
+    };
+
+    /* Over the budget: the fine scope is disabled, the other one samples less often */
+    run(50);
+    assert(fine_scope.registered() && normal_scope.registered());
+    assert(fine_scope.disabled());
+    assert(!normal_scope.disabled());
+    assert(normal_scope.period() > 1);
+    assert(controller.overhead_ratio() > options.budget);
+
+    /* The recorded calls are the sampler's calls, extrapolated from the samples */
+    uint32_t throttled = normal_scope.period();
+    run(10 * throttled);
+    assert(normal_scope.samples() > 1);
+    assert(calls_of(recorder, normal) == normal_scope.calls());
+    assert(normal_scope.calls() <= 50 + 10 * throttled);
+
+    /* Well under the budget: the disabled scope is enabled again, the periods get back */
+    run(0);
+    assert(!fine_scope.disabled());
+    assert(fine_scope.period() == options.max_period);
+    for (int i = 0; i < 20 && normal_scope.period() > 1; i++) {
+        run(0);
+    }
+    assert(normal_scope.period() == 1);
+
+    /* Still too expensive: disabled again */
+    run(50 * options.max_period);
+    assert(fine_scope.disabled());
+
+    return 0;
+}
@@ -0,0 +1,71 @@
+#include "../fiya-collapsed.h"
+#include <cassert>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+using namespace fiya;
+
+std::string collapsed(recorder_t<const char*, uint64_t>& recorder) {
+    std::ostringstream out;
+    recorder.to_collapsed_stacks(out, [] (std::ostream& os, const char* const & l) { os << l; },
+                                      [] (std::ostream& os, const uint64_t& m) { os << m; });
+    return out.str();
+}
+
+int main(int argc, char ** argv) {
+    /* Parsing the output of to_collapsed_stacks gives the same tree */
+    recorder_t<const char*, uint64_t> original(0, "root", 5);
+    original.begin_scope("main");
+    original.cnt() += 10;
+    original.begin_scope("parse file");
+    original.cnt() += 20;
+    original.end_scope();
+    original.begin_scope("merge");
+    original.cnt() += 30;
+    original.end_scope();
+    original.end_scope();
+    std::string text = collapsed(original);
+
+    recorder_t<const char*, uint64_t> parsed(0, "root", 0);
+    auto result = parse_collapsed_stacks(text.data(), text.size(), parsed);
+    assert(result.lines == 4);
+    assert(result.malformed == 0);
+    assert(collapsed(parsed) == text);
+
+    /* Malformed lines are skipped, CRLF and a missing final newline are accepted */
+    std::string messy = "root;a 1\r\nno value\nroot;a;b x\n\nroot;a;b 2";
+    recorder_t<const char*, uint64_t> messy_recorder(0, "root", 0);
+    result = parse_collapsed_stacks(messy.data(), messy.size(), messy_recorder);
+    assert(result.lines == 2);
+    assert(result.malformed == 2);
+    assert(collapsed(messy_recorder) == "root 0\nroot;a 1\nroot;a;b 2\n");
+
+    /* Without a root frame, all frames go under the root */
+    collapsed_parse_options_t options;
+    options.root_frame = false;
+    std::string perf = "a;b 3\n";
+    recorder_t<const char*, uint64_t> perf_recorder(0, "all", 0);
+    parse_collapsed_stacks(perf.data(), perf.size(), perf_recorder, options);
+    assert(collapsed(perf_recorder) == "all 0\nall;a 0\nall;a;b 3\n");
+
+    /* Merging files in parallel */
+    std::vector<std::string> paths;
+    for (int i = 0; i < 8; i++) {
+        paths.push_back("fiya-collapsed-test-" + std::to_string(i) + ".txt");
+        std::ofstream file(paths.back());
+        file << text;
+    }
+    paths.push_back("fiya-collapsed-test-missing.txt");
+
+    recorder_t<const char*, uint64_t> merged(0, "root", 0);
+    result = merge_collapsed_files(paths, merged, 3);
+    assert(result.lines == 32);
+    assert(result.failed_files == 1);
+    assert(collapsed(merged) == "root 40\nroot;main 80\nroot;main;parse file 160\nroot;main;merge 240\n");
+
+    for (int i = 0; i < 8; i++) {
+        std::remove(paths[i].c_str());
+    }
+    return 0;
+}
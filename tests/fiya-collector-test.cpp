@@ -0,0 +1,129 @@
+#include "../fiya-collector.h"
+#include <cassert>
+#include <cstdio>
+#include <sstream>
+
+using namespace fiya;
+
+std::string collapsed(delta_collector_t::recorder_type& recorder) {
+    std::ostringstream out;
+    recorder.to_collapsed_stacks(out, [] (std::ostream& os, const char* const & l) { os << l; },
+                                      [] (std::ostream& os, const uint64_t& m) { os << m; });
+    return out.str();
+}
+
+/** Receives all pending datagrams of @fd into @collector */
+size_t receive(int fd, delta_collector_t& collector) {
+    char buffer[65536];
+    size_t count { 0U };
+    for (;;) {
+        ssize_t size = recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+        if (size <= 0) {
+            return count;
+        }
+        assert(collector.add_datagram(buffer, static_cast<size_t>(size)));
+        count++;
+    }
+}
+
+int main(int argc, char ** argv) {
+    /* Encoding and decoding */
+    delta_encoder_t encoder;
+    encoder.begin("server", "tenant-a");
+    encoder.add({ "root" }, 1);
+    encoder.add({ "root", "parse" }, 300);
+    encoder.add({ "root", "parse", "root" }, 2);
+    encoder.add({ "root", "write" }, 4);
+
+    std::ostringstream decoded;
+    assert(decode_delta(encoder.data().data(), encoder.data().size(),
+        [&decoded] (const std::string& binary, const std::string& tag, const std::vector<std::string>& path, uint64_t delta) {
+            decoded << binary << "/" << tag << ":";
+            for (const std::string& frame : path) {
+                decoded << frame << ";";
+            }
+            decoded << delta << "\n";
+        }));
+    assert(decoded.str() == "server/tenant-a:root;1\nserver/tenant-a:root;parse;300\n"
+                            "server/tenant-a:root;parse;root;2\nserver/tenant-a:root;write;4\n");
+    /* Truncated datagrams are rejected */
+    assert(!decode_delta(encoder.data().data(), encoder.data().size() - 1, [] (const std::string&, const std::string&, const std::vector<std::string>&, uint64_t) {}));
+
+    /* Exporting to a local socket */
+    std::string socket_path { "fiya-collector-test.sock" };
+    unlink(socket_path.c_str());
+    int fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+    assert(bind(fd, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) == 0);
+
+    recorder_t<const char*, uint64_t> recorder(0, "root", 0);
+    recorder.begin_scope("handle");
+    recorder.cnt() += 10;
+    recorder.end_scope();
+
+    auto l_out = [] (std::ostream& os, const char* const & l) { os << l; };
+    auto m_value = [] (const uint64_t& m) { return m; };
+    /* Small datagrams, to split the deltas */
+    delta_exporter_t exporter(socket_path, "server", 16);
+    assert(exporter.send(recorder, l_out, m_value) == 1);
+
+    recorder.begin_scope("handle");
+    recorder.cnt() += 5;
+    recorder.begin_scope("parse");
+    recorder.cnt() += 7;
+    recorder.end_scope();
+    recorder.end_scope();
+    assert(exporter.send(recorder, l_out, m_value) == 2);
+    /* Nothing changed, nothing is sent */
+    assert(exporter.send(recorder, l_out, m_value) == 0);
+    assert(exporter.send(recorder, l_out, m_value, "tagged") == 2);
+
+    delta_collector_t collector;
+    assert(receive(fd, collector) == 5);
+    size_t profiles { 0U };
+    collector.for_each([&] (const std::string& binary, const std::string& tag, delta_collector_t::recorder_type& r) {
+        assert(binary == "server");
+        assert(tag.empty() || tag == "tagged");
+        assert(collapsed(r) == "root 0\nroot;handle 15\nroot;handle;parse 7\n");
+        profiles++;
+    });
+    assert(profiles == 2);
+
+    /* A path with another root is kept below the root of the profile */
+    encoder.begin("server", "");
+    encoder.add({ "main", "handle" }, 3);
+    assert(collector.add_datagram(encoder.data().data(), encoder.data().size()));
+    collector.for_each([&] (const std::string&, const std::string& tag, delta_collector_t::recorder_type& r) {
+        if (tag.empty()) {
+            assert(collapsed(r) == "root 0\nroot;handle 15\nroot;handle;parse 7\nroot;main 0\nroot;main;handle 3\n");
+        }
+    });
+
+    /* Without a collector the datagrams are dropped and the deltas kept */
+    close(fd);
+    unlink(socket_path.c_str());
+    recorder.begin_scope("handle");
+    recorder.cnt() += 1;
+    recorder.end_scope();
+    assert(exporter.send(recorder, l_out, m_value) == 0);
+    assert(exporter.dropped_datagrams() == 1);
+
+    fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+    assert(bind(fd, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) == 0);
+    recorder.begin_scope("handle");
+    recorder.cnt() += 1;
+    recorder.end_scope();
+    assert(exporter.send(recorder, l_out, m_value) == 1);
+    delta_collector_t later;
+    assert(receive(fd, later) == 1);
+    later.for_each([&] (const std::string&, const std::string&, delta_collector_t::recorder_type& r) {
+        assert(collapsed(r) == "root 0\nroot;handle 2\n");
+    });
+
+    close(fd);
+    unlink(socket_path.c_str());
+    return 0;
+}
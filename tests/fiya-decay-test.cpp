@@ -0,0 +1,54 @@
+#include "../fiya-decay.h"
+#include <cassert>
+#include <cmath>
+#include <sstream>
+
+using namespace fiya;
+
+bool near(double v1, double v2) {
+    return std::fabs(v1 - v2) < 1e-9 * std::max(1.0, std::fabs(v2));
+}
+
+int main(int argc, char ** argv) {
+    decay_t decay(std::chrono::seconds(1), 4);
+    assert(decay.epoch_length() == std::chrono::milliseconds(250));
+    assert(near(decay.factor(0), 1.0));
+    assert(near(decay.factor(4), 0.5));
+    assert(near(decay.factor(2), std::sqrt(0.5)));
+    assert(decay.factor(1000) == 0.0);
+
+    /* Values decay lazily, on update and on read */
+    decayed_value_t v;
+    v.add(100.0, 0, decay);
+    assert(near(v.read(0, decay), 100.0));
+    assert(near(v.read(4, decay), 50.0));
+    assert(near(v.read(8, decay), 25.0));
+    v.add(10.0, 4, decay);
+    assert(v.epoch == 4);
+    assert(near(v.value, 60.0));
+    assert(near(v.read(8, decay), 30.0));
+
+    /* An epoch taken before the last update doesn't wrap around */
+    assert(near(v.read(2, decay), 60.0));
+    v.add(20.0, 0, decay);
+    assert(v.epoch == 4);
+    assert(near(v.value, 70.0));
+
+    /* Recorder with decayed counters */
+    recorder_t<int, decayed_value_t> recorder(decayed_value_t{}, 0, decayed_value_t{});
+    recorder.begin_scope(1);
+    add_decayed(&recorder, 42.0, decay);
+    recorder.end_scope();
+
+    recorder_t<int, decayed_value_t> other(decayed_value_t{}, 0, decayed_value_t{});
+    other.begin_scope(1);
+    add_decayed(&other, 8.0, decay);
+    other.end_scope();
+    recorder.merge(other, decayed_merge(decay));
+
+    std::ostringstream out;
+    recorder.to_collapsed_stacks(out, [] (std::ostream& os, const int& l) { os << l; }, decayed_out(decay));
+    assert(out.str() == "0 0\n0;1 50\n");
+
+    return 0;
+}
@@ -0,0 +1,103 @@
+#include "../fiya-event-log.h"
+#include <cassert>
+#include <string>
+#include <sstream>
+
+using namespace fiya;
+
+/** Logs a scope of @ns nanoseconds at @t and returns its end */
+uint64_t scope(event_log_t<int>& log, int label, uint64_t t, uint64_t ns) {
+    log.begin_at(label, t);
+    log.end_at(t + ns);
+    return t + ns;
+}
+
+std::string decoded(const event_log_t<int>& log) {
+    std::ostringstream out;
+    log.for_each_event([&out] (const log_event_t<int>& e) {
+        if (e.kind == log_kind_t::begin) {
+            out << "(" << e.label;
+        } else {
+            out << ":" << e.total_ns << "/" << e.iterations << ")";
+        }
+    });
+    return out.str();
+}
+
+int main(int argc, char ** argv) {
+    /* A loop of one scope takes three records */
+    event_log_t<int> loop;
+    uint64_t t { 0U };
+    loop.begin_at(1, t);
+    for (int i = 0; i < 1000; i++) {
+        t = scope(loop, 2, t, i + 1);
+    }
+    loop.end_at(t);
+    assert(loop.size() == 5);
+    assert(loop.records()[3].kind == log_kind_t::repeat);
+    assert(loop.records()[3].value == 999);
+    assert(loop.event_count() == 2002);
+    /* The sum of the durations is kept */
+    assert(loop.records()[2].value == 1000 * 1001 / 2);
+    assert(loop.records()[4].value == t);
+
+    /* Sibling sequences keep their order */
+    event_log_t<int> pairs;
+    t = 0;
+    for (int i = 0; i < 3; i++) {
+        t = scope(pairs, 1, t, 10);
+        t = scope(pairs, 2, t, 20);
+    }
+    t = scope(pairs, 3, t, 5);
+    assert(pairs.size() == 7);
+    assert(decoded(pairs) == "(1:30/3)(2:60/3)(1:30/3)(2:60/3)(1:30/3)(2:60/3)(3:5/1)");
+
+    /* Nested loops, with the same inner trip count */
+    event_log_t<int> nested;
+    t = 0;
+    for (int i = 0; i < 4; i++) {
+        nested.begin_at(1, t);
+        for (int j = 0; j < 5; j++) {
+            t = scope(nested, 2, t, 1);
+        }
+        nested.end_at(t);
+    }
+    assert(nested.size() == 6);
+    assert(nested.event_count() == 4 * 12);
+
+    recorder_t<int, uint64_t> recorder(0, 0, 0);
+    nested.to_recorder(recorder);
+    std::ostringstream out;
+    recorder.to_collapsed_stacks(out, [] (std::ostream& os, const int& l) { os << l; },
+                                      [] (std::ostream& os, const uint64_t& m) { os << m; });
+    assert(out.str() == "0 0\n0;1 0\n0;1;2 20\n");
+
+    /* Different structure is not folded */
+    event_log_t<int> different;
+    t = scope(different, 1, 0, 1);
+    t = scope(different, 2, t, 1);
+    t = scope(different, 3, t, 1);
+    assert(different.size() == 6);
+    assert(decoded(different) == "(1:1/1)(2:1/1)(3:1/1)");
+
+    /* Repeats inside repeated sequences */
+    event_log_t<int> inner;
+    t = 0;
+    for (int i = 0; i < 3; i++) {
+        t = scope(inner, 1, t, 1);
+        t = scope(inner, 1, t, 1);
+        t = scope(inner, 2, t, 1);
+    }
+    assert(inner.size() == 6);
+    assert(decoded(inner) == "(1:6/6)(1:6/6)(2:3/3)(1:6/6)(1:6/6)(2:3/3)(1:6/6)(1:6/6)(2:3/3)");
+    assert(inner.event_count() == 18);
+
+    /* Labels saved in the label database */
+    event_log_t<const char*> names;
+    for (int i = 0; i < 10; i++) {
+        log_scope_t<const char*> s(std::string("work").c_str(), &names);
+    }
+    assert(names.size() == 3);
+
+    return 0;
+}
@@ -0,0 +1,126 @@
+#include "../fiya-time-measure.h"
+#include "../fiya-exception-measure.h"
+#include <new>
+#include <chrono>
+#include <cassert>
+#include <cstdlib>
+#include <sstream>
+#include <stdexcept>
+
+/** Link with fiya-exception-overloads.cpp and -ldl */
+
+using namespace fiya;
+
+measure_time_t<const char*>::recorder_type time_recorder({}, "root", time_value_t::now());
+measure_exception_t<const char*>::recorder_type exception_recorder(exception_usage_t{}, "root", exception_usage_t{});
+
+/** When set, operator new fails */
+bool fail_allocations = false;
+
+void * operator new(size_t size) {
+    void * p = fail_allocations ? nullptr : malloc(size);
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void * p) noexcept {
+    free(p);
+}
+
+void operator delete(void * p, size_t) noexcept {
+    free(p);
+}
+
+/** Uses @ms milliseconds of CPU time */
+void burn_cpu(int ms) {
+    auto start = get_thread_time<void>();
+    while (get_thread_time<void>() - start < std::chrono::milliseconds(ms)) {
+    }
+}
+
+fiya::counter_interface_t<fiya::exception_usage_t> * get_exception_counter() {
+    return &exception_recorder;
+}
+
+void parse(int i) {
+    measure_time_t<const char*> m1("parse", &time_recorder);
+    measure_exception_t<const char*> m2("parse", &exception_recorder);
+    if (i % 2 == 0) {
+        throw std::runtime_error("bad input");
+    }
+}
+
+void load() {
+    measure_time_t<const char*> m1("load", &time_recorder);
+    measure_exception_t<const char*> m2("load", &exception_recorder);
+    for (int i = 0; i < 6; i++) {
+        try {
+            parse(i);
+        } catch (const std::exception&) {
+        }
+    }
+    throw std::logic_error("cannot load");
+}
+
+int main(int argc, char ** argv) {
+    try {
+        load();
+    } catch (const std::exception&) {
+    }
+
+    /* All scopes were closed during unwinding, so a new scope is a child of root */
+    {
+        measure_time_t<const char*> m("after", &time_recorder);
+    }
+
+    size_t paths = 0;
+    time_recorder.for_each_path([&] (const std::vector<const char*>& path, const time_value_t&) {
+        if (strcmp(path.back(), "after") == 0) {
+            assert(path.size() == 2);
+        }
+        if (strcmp(path.back(), "parse") == 0) {
+            assert(path.size() == 3);
+        }
+        paths++;
+    });
+    assert(paths == 4);
+
+    std::ostringstream report;
+    to_throw_report<const char*>(exception_recorder, report, [] (std::ostream& os, const char* const & l) {
+        os << l;
+    });
+
+    std::istringstream lines(report.str());
+    std::string line;
+    std::getline(lines, line);
+    assert(line.find("3 ") == 0);
+    assert(line.find(" root;load;parse") != std::string::npos);
+    std::getline(lines, line);
+    assert(line.find("1 ") == 0);
+    assert(line.find(" root;load") != std::string::npos);
+    assert(!std::getline(lines, line));
+
+    /* A scope whose node can't be allocated doesn't count the parent's time twice */
+    measure_time_t<const char*>::recorder_type failing_recorder({}, "root", time_value_t::now());
+    {
+        measure_time_t<const char*> m1("outer", &failing_recorder);
+        burn_cpu(20);
+        fail_allocations = true;
+        try {
+            measure_time_t<const char*> m2("new", &failing_recorder);
+            assert(false);
+        } catch (const std::bad_alloc&) {
+        }
+        fail_allocations = false;
+        measure_time_t<const char*> m3("next", &failing_recorder);
+    }
+    failing_recorder.for_each_path([&] (const std::vector<const char*>& path, const time_value_t& m) {
+        assert(strcmp(path.back(), "new") != 0);
+        if (strcmp(path.back(), "outer") == 0) {
+            assert(m.get_duration() >= std::chrono::milliseconds(20));
+            assert(m.get_duration() < std::chrono::milliseconds(30));
+        }
+    });
+}
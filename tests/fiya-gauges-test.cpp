@@ -0,0 +1,65 @@
+#include "../fiya-gauges.h"
+#include "../fiya-heatmap.h"
+#include <atomic>
+#include <cassert>
+#include <sstream>
+
+using namespace fiya;
+
+int main(int argc, char ** argv) {
+    /* The ring keeps the last samples */
+    gauge_ring_t ring(3);
+    for (int i = 0; i < 5; i++) {
+        ring.push(gauge_sample_t{ static_cast<uint64_t>(i), static_cast<double>(i) });
+    }
+    assert(ring.size() == 3);
+    assert(ring[0].value == 2.0);
+    assert(ring[2].value == 4.0);
+
+    std::atomic<int> queue_depth { 0 };
+    gauge_sampler_t sampler(std::chrono::milliseconds(1), 2);
+    sampler.add_gauge("queue \"depth\"", [&queue_depth] { return static_cast<double>(queue_depth.load()); });
+    sampler.add_current_thread("main");
+
+    for (int i = 0; i < 3; i++) {
+        queue_depth = 10 + i;
+        sampler.sample_now();
+    }
+
+    std::ostringstream out;
+    sampler.to_chrome_trace(out);
+    std::string trace = out.str();
+    assert(trace.find("{\"traceEvents\":[") == 0);
+    assert(trace.find("\"name\":\"queue \\\"depth\\\"\",\"ph\":\"C\"") != std::string::npos);
+    assert(trace.find("{\"value\":10}") == std::string::npos);
+    assert(trace.find("{\"value\":11}") != std::string::npos);
+    assert(trace.find("{\"value\":12}") != std::string::npos);
+    assert(trace.find("\"name\":\"CPU main\"") != std::string::npos);
+    assert(trace.find("\"ph\":\"M\"") != std::string::npos);
+
+    /* Relative to the origin of a heatmap recorder, samples before it are left out */
+    heatmap_recorder_t<int> recorder(0);
+    assert(recorder.origin_ns() <= gauge_now_ns());
+    std::ostringstream empty;
+    sampler.to_chrome_trace(empty, recorder.origin_ns());
+    assert(empty.str().find("\"ph\":\"C\"") == std::string::npos);
+
+    queue_depth = 20;
+    sampler.sample_now();
+    std::ostringstream aligned;
+    sampler.to_chrome_trace(aligned, recorder.origin_ns());
+    std::string aligned_trace = aligned.str();
+    assert(aligned_trace.find("{\"value\":12}") == std::string::npos);
+    size_t ts = aligned_trace.find("\"ts\":");
+    assert(ts != std::string::npos);
+    assert(aligned_trace.find("{\"value\":20}") != std::string::npos);
+    /* Microseconds since the origin, not since the epoch of the steady clock */
+    assert(std::stod(aligned_trace.substr(ts + 5)) < 1e6);
+
+    /* The background sampler */
+    sampler.start();
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    sampler.stop();
+
+    return 0;
+}
@@ -0,0 +1,146 @@
+#include "../fiya-heatmap.h"
+#include <cassert>
+#include <set>
+#include <sstream>
+#include <string>
+
+using namespace fiya;
+
+using label_out_t = std::function<void(std::ostream& os, const int& l)>;
+
+/** Uses @ms milliseconds of CPU time */
+void burn_cpu(int ms) {
+    auto start = get_thread_time<void>();
+    while (get_thread_time<void>() - start < std::chrono::milliseconds(ms)) {
+    }
+}
+
+uint64_t steady_ns() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+/** Returns the paths of the collapsed stacks written by @write */
+std::set<std::string> paths(const std::function<void(std::ostream& os, const label_out_t& l_out)>& write) {
+    std::ostringstream out;
+    write(out, [] (std::ostream& os, const int& l) { os << l; });
+    std::set<std::string> result;
+    std::istringstream in(out.str());
+    std::string line;
+    while (std::getline(in, line)) {
+        result.insert(line.substr(0, line.find(' ')));
+    }
+    return result;
+}
+
+int main(int argc, char ** argv) {
+    /* 4 columns of 100 ns, 10 rows of 10 ns */
+    heatmap_t<4, 10> heatmap(std::chrono::nanoseconds(100));
+    assert(heatmap.column_ns() == 100);
+
+    /* An interval is split between the cells it covers */
+    heatmap.add(5, 25, 200);
+    heatmap.add(130, 130, 7);
+
+    std::vector<uint64_t> cells;
+    heatmap.for_each_cell([&cells] (uint64_t column, size_t row, uint64_t value_ns) {
+        assert(row < 10);
+        assert(column < 2);
+        cells.push_back(value_ns);
+    });
+    assert(cells.size() == 20);
+    assert(cells[0] == 50);
+    assert(cells[1] == 100);
+    assert(cells[2] == 50);
+    assert(cells[13] == 7);
+
+    /* Columns older than the ring are reused */
+    heatmap.add(1000, 1000, 3);
+    uint64_t first_column = UINT64_MAX;
+    uint64_t total = 0;
+    heatmap.for_each_cell([&] (uint64_t column, size_t, uint64_t value_ns) {
+        first_column = std::min(first_column, column);
+        total += value_ns;
+    });
+    assert(first_column == 7);
+    assert(total == 3);
+
+    /* Long intervals with much CPU time don't overflow the proportion */
+    heatmap_t<2, 1> seconds;
+    seconds.add(0, 2000000000, 1000000000000);
+    total = 0;
+    seconds.for_each_cell([&] (uint64_t, size_t, uint64_t value_ns) {
+        total += value_ns;
+    });
+    assert(total == 1000000000000);
+
+    std::ostringstream svg;
+    heatmap.to_svg(svg);
+    assert(svg.str().find("<svg") == 0);
+
+    /* The recorder builds the tree and the ring of transitions */
+    heatmap_recorder_t<int, 4, 10, 16, 8> recorder(0);
+    recorder.select_label(2);
+    {
+        measure_heatmap_t<decltype(recorder)> m1(1, &recorder);
+        {
+            measure_heatmap_t<decltype(recorder)> m2(2, &recorder);
+        }
+    }
+
+    std::ostringstream out;
+    recorder.to_range_collapsed_stacks(out, [] (std::ostream& os, const int& l) { os << l; }, 0, 0);
+    assert(out.str().empty());
+    assert(recorder.events_begin_ns() == 0);
+
+    /* Room for the root and 3 nodes, all transitions stay in the ring */
+    heatmap_recorder_t<int, 4, 10, 4, 64> small(0);
+    small.select_label(2);
+    {
+        measure_heatmap_t<decltype(small)> m1(1, &small);
+        burn_cpu(1);
+        {
+            measure_heatmap_t<decltype(small)> m2(2, &small);
+            burn_cpu(5);
+        }
+    }
+    uint64_t middle_ns = steady_ns() - small.origin_ns();
+    {
+        measure_heatmap_t<decltype(small)> m1(1, &small);
+        measure_heatmap_t<decltype(small)> m3(3, &small);
+        burn_cpu(1);
+    }
+    {
+        /* The tree is full, the time is accounted to the root */
+        measure_heatmap_t<decltype(small)> m4(4, &small);
+        burn_cpu(1);
+    }
+
+    assert(paths([&small] (std::ostream& os, const label_out_t& l_out) {
+        small.to_collapsed_stacks(os, l_out);
+    }) == std::set<std::string>({ "0", "0;1", "0;1;2", "0;1;3" }));
+
+    /* The ranges before and after the middle */
+    std::set<std::string> before = paths([&] (std::ostream& os, const label_out_t& l_out) {
+        small.to_range_collapsed_stacks(os, l_out, 0, middle_ns);
+    });
+    assert(before.count("0;1;2") == 1 && before.count("0;1") == 1 && before.count("0;1;3") == 0);
+    std::set<std::string> after = paths([&] (std::ostream& os, const label_out_t& l_out) {
+        small.to_range_collapsed_stacks(os, l_out, middle_ns, UINT64_MAX);
+    });
+    assert(after.count("0;1;3") == 1 && after.count("0") == 1 && after.count("0;1;2") == 0);
+    assert(small.events_begin_ns() == 0);
+
+    /* The label heatmap has the time of label 2 only */
+    uint64_t thread_ns = 0, label_ns = 0;
+    small.thread_heatmap().for_each_cell([&thread_ns] (uint64_t, size_t, uint64_t value_ns) {
+        thread_ns += value_ns;
+    });
+    small.label_heatmap().for_each_cell([&label_ns] (uint64_t, size_t, uint64_t value_ns) {
+        label_ns += value_ns;
+    });
+    assert(label_ns >= 5000000);
+    assert(thread_ns >= label_ns + 3000000);
+
+    return 0;
+}
@@ -0,0 +1,80 @@
+#include "../fiya-io-measure.h"
+#include <cerrno>
+#include <cassert>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+
+/** Link with fiya-io-overloads.cpp and -ldl */
+
+using namespace fiya;
+
+measure_io_t<const char*>::recorder_type io_recorder(io_usage_t{}, "root", io_usage_t{});
+
+fiya::counter_interface_t<fiya::io_usage_t> * get_io_counter() {
+    return &io_recorder;
+}
+
+/** Returns the value of the scope @label below the root */
+io_usage_t scope_value(const char * label) {
+    io_usage_t result;
+    io_recorder.for_each_path([&] (const std::vector<const char*>& path, const io_usage_t& value) {
+        if (path.size() == 2 && std::string(path[1]) == label) {
+            result = value;
+        }
+    });
+    return result;
+}
+
+int main() {
+    int fds[2];
+    assert(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    char buf[64];
+
+    {
+        measure_io_t<const char*> m("pipe", &io_recorder);
+        assert(write(fds[0], "hello", 5) == 5);
+        assert(read(fds[1], buf, sizeof(buf)) == 5);
+    }
+    io_usage_t pipe = scope_value("pipe");
+    assert(pipe.calls == 2);
+    assert(pipe.bytes_written == 5 && pipe.bytes_read == 5);
+
+    {
+        measure_io_t<const char*> m("socket", &io_recorder);
+        assert(sendto(fds[0], "abc", 3, 0, nullptr, 0) == 3);
+        assert(recvfrom(fds[1], buf, sizeof(buf), 0, nullptr, nullptr) == 3);
+
+        struct iovec iov = { const_cast<char*>("defg"), 4 };
+        struct msghdr msg = {};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        assert(sendmsg(fds[0], &msg, 0) == 4);
+        iov.iov_base = buf;
+        iov.iov_len = sizeof(buf);
+        assert(recvmsg(fds[1], &msg, 0) == 4);
+    }
+    io_usage_t socket = scope_value("socket");
+    assert(socket.calls == 4);
+    assert(socket.bytes_written == 7 && socket.bytes_read == 7);
+
+    /* The caller sees the errno of the failed call */
+    {
+        measure_io_t<const char*> m("failed", &io_recorder);
+        errno = 0;
+        assert(read(-1, buf, sizeof(buf)) == -1);
+        assert(errno == EBADF);
+        errno = 0;
+        assert(fsync(-1) == -1);
+        assert(errno == EBADF);
+    }
+    io_usage_t failed = scope_value("failed");
+    assert(failed.calls == 2);
+    assert(failed.bytes_read == 0);
+
+    close(fds[0]);
+    close(fds[1]);
+    return 0;
+}
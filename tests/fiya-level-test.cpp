@@ -0,0 +1,68 @@
+#include "../fiya-heap-measure.h"
+#include <cassert>
+#include <set>
+#include <string>
+
+using namespace fiya;
+
+using my_recorder_t = measure_heap_t<int>::recorder_type;
+
+/** Returns the paths in the tree, e.g. "0;1;2" */
+std::set<std::string> paths(my_recorder_t& recorder) {
+    std::set<std::string> result;
+    recorder.for_each_path([&] (const std::vector<int>& path, const heap_usage_t&) {
+        std::string key;
+        for (int l: path) {
+            key += key.empty() ? std::to_string(l) : ";" + std::to_string(l);
+        }
+        result.insert(key);
+    });
+    return result;
+}
+
+int main(int argc, char ** argv) {
+    /* By default everything is recorded */
+    {
+        my_recorder_t recorder(heap_usage_t{}, 0, heap_usage_t{});
+        {
+            measure_heap_t<int> m1(1, &recorder, level_t::coarse);
+            measure_heap_t<int> m2(2, &recorder, level_t::fine);
+        }
+        assert((paths(recorder) == std::set<std::string>{ "0", "0;1", "0;1;2" }));
+    }
+
+    /* Fine scopes are skipped, their children go to the enclosing scope */
+    set_level(level_t::normal);
+    {
+        my_recorder_t recorder(heap_usage_t{}, 0, heap_usage_t{});
+        {
+            measure_heap_t<int> m1(1, &recorder, level_t::coarse);
+            measure_heap_t<int> m2(2, &recorder, level_t::fine);
+            measure_heap_t<int> m3(3, &recorder);
+        }
+        assert((paths(recorder) == std::set<std::string>{ "0", "0;1", "0;1;3" }));
+    }
+
+    /* Switching the level and disabling inside a scope keeps the nesting */
+    set_level(level_t::coarse);
+    {
+        my_recorder_t recorder(heap_usage_t{}, 0, heap_usage_t{});
+        {
+            measure_heap_t<int> m1(1, &recorder, level_t::normal);
+            set_level(level_t::fine);
+            measure_heap_t<int> m2(2, &recorder, level_t::fine);
+            set_enabled(false);
+            measure_heap_t<int> m3(3, &recorder, level_t::coarse);
+            set_enabled(true);
+            measure_heap_t<int> m4(4, &recorder, level_t::coarse);
+            set_level(level_t::coarse);
+        }
+        measure_heap_t<int> m5(5, &recorder, level_t::coarse);
+        assert(!recorder.recorder_internal_running());
+        assert((paths(recorder) == std::set<std::string>{ "0", "0;2", "0;2;4", "0;5" }));
+    }
+    assert(get_level() == level_t::coarse);
+    assert(is_enabled());
+
+    return 0;
+}
@@ -0,0 +1,54 @@
+#include "../fiya-perf-measure.h"
+#include <cassert>
+#include <thread>
+#include <chrono>
+
+using namespace fiya;
+
+int main(int argc, char ** argv) {
+    perf_counters_t counters;
+
+    /* Each sleep blocks the thread, a voluntary context switch */
+    for (int i = 0; i < 20; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        std::this_thread::yield();
+    }
+    perf_value_t elapsed = counters.elapsed();
+    assert(elapsed.context_switches >= 20);
+
+    /* Charged to the scope that was active */
+    recorder_t<const char*, perf_value_t> recorder(perf_value_t(), "root", perf_value_t());
+    {
+        measure_perf_t<const char*> m("sleep", &recorder, &counters);
+        for (int i = 0; i < 5; i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    uint64_t switches { 0U };
+    recorder.for_each_path([&] (const std::vector<const char*>& path, const perf_value_t& m) {
+        if (path.size() == 2) {
+            switches = m.context_switches;
+        }
+    });
+    assert(switches >= 5);
+
+    /* The increments never wrap, whatever the source of the counters */
+    perf_counters_t hardware(true);
+    volatile uint64_t sum = 0;
+    for (int i = 0; i < 1000; i++) {
+        for (int j = 0; j < 1000; j++) {
+            sum += j;
+        }
+        perf_value_t step = hardware.elapsed();
+        assert(step.context_switches < (1ULL << 32) && step.minor_faults < (1ULL << 32));
+        assert(step.cycles < (1ULL << 40) && step.instructions < (1ULL << 40));
+    }
+    perf_value_t total = hardware.read();
+    if (hardware.hardware_enabled()) {
+        assert(total.instructions > 1000000);
+    } else {
+        assert(total.cycles == 0 && total.instructions == 0);
+    }
+
+    return 0;
+}
@@ -0,0 +1,100 @@
+#include "../fiya-recorder.h"
+#include <cassert>
+#include <map>
+#include <string>
+
+using namespace fiya;
+
+using my_recorder_t = recorder_t<const char*, uint64_t>;
+
+/** Records @value in the scope given by the labels */
+void record(my_recorder_t& recorder, std::initializer_list<const char*> labels, uint64_t value) {
+    for (const char* l: labels) {
+        recorder.begin_scope(l);
+    }
+    recorder.cnt() += value;
+    for (size_t i = 0; i < labels.size(); i++) {
+        recorder.end_scope();
+    }
+}
+
+/** Returns the tree as path -> value */
+std::map<std::string, uint64_t> to_map(my_recorder_t& recorder) {
+    std::map<std::string, uint64_t> result;
+    recorder.for_each_path([&] (const std::vector<const char*>& path, const uint64_t& value) {
+        std::string key;
+        for (const char* l: path) {
+            key += key.empty() ? l : std::string(";") + l;
+        }
+        result[key] = value;
+    });
+    return result;
+}
+
+int main(int argc, char ** argv) {
+    my_recorder_t r1(0ULL, "root", 0ULL);
+    my_recorder_t r2(0ULL, "root", 0ULL);
+
+    record(r1, { "a", "b" }, 1);
+    record(r1, { "a" }, 2);
+    record(r2, { "a", "b" }, 10);
+    record(r2, { "c" }, 20);
+
+    r1.merge(r2);
+
+    std::map<std::string, uint64_t> merged = to_map(r1);
+    assert(merged.size() == 4);
+    assert(merged["root"] == 0);
+    assert(merged["root;a"] == 2);
+    assert(merged["root;a;b"] == 11);
+    assert(merged["root;c"] == 20);
+
+    /* The recorder merged from is unchanged */
+    assert(to_map(r2).size() == 4);
+    assert(to_map(r2)["root;a;b"] == 10);
+
+    /* Merging with an operation and another measure type */
+    recorder_t<const char*, double> r3(0.0, "root", 0.0);
+    r3.merge(r1, [] (double& dst, const uint64_t& src) {
+        dst += src * 0.5;
+    });
+    auto report = r3.to_report();
+    for (const auto& v: report.report) {
+        if (strcmp(v.first, "b") == 0) {
+            assert(v.second.self == 5.5);
+        }
+        if (strcmp(v.first, "a") == 0) {
+            assert(v.second.total == 6.5);
+        }
+    }
+
+    /* Reset keeps the paths, with default values */
+    r2.reset(7ULL);
+    std::map<std::string, uint64_t> reset = to_map(r2);
+    assert(reset.size() == 4);
+    assert(reset["root"] == 7);
+    assert(reset["root;a;b"] == 0);
+    assert(reset["root;c"] == 0);
+    record(r2, { "a", "b" }, 3);
+    assert(to_map(r2)["root;a;b"] == 3);
+
+    /* The inverted tree has the self values of each label by caller */
+    my_recorder_t calls(0ULL, "root", 1ULL);
+    record(calls, { "main", "parse", "alloc" }, 5);
+    record(calls, { "main", "write", "alloc" }, 3);
+    record(calls, { "main", "parse" }, 2);
+    record(calls, { "main" }, 1);
+    my_recorder_t inverted(0ULL, "root", 0ULL);
+    calls.to_inverted(inverted);
+    std::map<std::string, uint64_t> bottom_up = to_map(inverted);
+    /* main;write has no self value, so there is no write leaf */
+    assert(bottom_up.size() == 9);
+    assert(bottom_up.count("root;write") == 0);
+    assert(bottom_up["root"] == 1);
+    assert(bottom_up["root;alloc"] == 0);
+    assert(bottom_up["root;alloc;parse"] == 0);
+    assert(bottom_up["root;alloc;parse;main"] == 5);
+    assert(bottom_up["root;alloc;write;main"] == 3);
+    assert(bottom_up["root;parse;main"] == 2);
+    assert(bottom_up["root;main"] == 1);
+}
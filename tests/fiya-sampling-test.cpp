@@ -0,0 +1,89 @@
+#include "../fiya-sampling.h"
+#include <cassert>
+#include <map>
+#include <string>
+
+using namespace fiya;
+
+using my_recorder_t = recorder_t<const char*, sampled_time_value_t>;
+using my_measure_time_t = measure_time_t<const char*, sampled_time_value_t>;
+
+/** Uses @us microseconds of CPU time */
+void burn_cpu(int us) {
+    auto start = get_thread_time<void>();
+    while (get_thread_time<void>() - start < std::chrono::microseconds(us)) {
+    }
+}
+
+/** Returns the tree as path -> value */
+std::map<std::string, sampled_time_value_t> to_map(my_recorder_t& recorder) {
+    std::map<std::string, sampled_time_value_t> result;
+    recorder.for_each_path([&] (const std::vector<const char*>& path, const sampled_time_value_t& value) {
+        std::string key;
+        for (const char* l: path) {
+            key += key.empty() ? l : std::string(";") + l;
+        }
+        result[key] = value;
+    });
+    return result;
+}
+
+/** Returns the self time of @m in milliseconds */
+double ms(const sampled_time_value_t& m) {
+    return std::chrono::duration<double, std::milli>(m.get_duration()).count();
+}
+
+/** A sampled scope with self time before and after a child scope */
+void sampled(my_recorder_t& recorder, sampler_t& sampler) {
+    sampled_measure_time_t<const char*> m("S", &recorder, sampler);
+    burn_cpu(100);
+    {
+        my_measure_time_t c("C", &recorder);
+        burn_cpu(100);
+    }
+    burn_cpu(10);
+}
+
+int main(int argc, char ** argv) {
+    /* The sampler stands for the invocations since the previous sample */
+    sampler_t every_third(3);
+    int samples = 0;
+    for (int i = 0; i < 9; i++) {
+        uint32_t weight = every_third.next();
+        assert(weight == 0 || weight == 3 || (i == 0 && weight == 1));
+        samples += weight > 0;
+    }
+    assert(every_third.samples() == static_cast<uint64_t>(samples));
+
+    /* A non-leaf sampled scope: its self time is extrapolated, its child is recorded as measured */
+    my_recorder_t recorder({}, "root", sampled_time_value_t::now());
+    sampler_t sampler(10);
+    {
+        my_measure_time_t outer("outer", &recorder);
+        for (int i = 0; i < 1000; i++) {
+            sampled(recorder, sampler);
+        }
+    }
+    std::map<std::string, sampled_time_value_t> tree = to_map(recorder);
+    assert(tree["root;outer;S"].calls + sampler.pending() == 1000);
+    assert(tree["root;outer;S"].samples == 100);
+    /* 1000 times 100 + 10 us of self time */
+    assert(ms(tree["root;outer;S"]) > 110 * 0.8 && ms(tree["root;outer;S"]) < 110 * 1.25);
+    /* The child is recorded as measured: below S when sampled, below outer otherwise */
+    assert(ms(tree["root;outer;S;C"]) > 10 * 0.8 && ms(tree["root;outer;S;C"]) < 10 * 1.25);
+    assert(ms(tree["root;outer;C"]) > 90 * 0.8 && ms(tree["root;outer;C"]) < 90 * 1.25);
+    /* The self time of the unrecorded invocations is removed from the enclosing scope */
+    assert(ms(tree["root;outer"]) > -10 && ms(tree["root;outer"]) < 10);
+
+    /* An inactive level doesn't count the invocations */
+    set_level(level_t::coarse);
+    sampler_t fine_sampler(2);
+    for (int i = 0; i < 10; i++) {
+        sampled_measure_time_t<const char*> m("fine", &recorder, fine_sampler, level_t::fine);
+    }
+    assert(fine_sampler.calls() == 0);
+    assert(to_map(recorder).count("root;fine") == 0);
+    set_level(level_t::fine);
+
+    return 0;
+}
@@ -0,0 +1,134 @@
+#include "../fiya-shared-recorder.h"
+#include <cassert>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <sys/wait.h>
+
+using namespace fiya;
+
+using my_recorder_t = shared_recorder_t<const char*, uint64_t>;
+
+std::string collapsed(const my_recorder_t& recorder) {
+    std::ostringstream out;
+    recorder.to_collapsed_stacks(out, [] (std::ostream& os, const char* const & l) { os << l; },
+                                      [] (std::ostream& os, const uint64_t& m) { os << m; });
+    return out.str();
+}
+
+int main(int argc, char ** argv) {
+    my_recorder_t recorder(0, "root", 64, 8);
+    my_recorder_t::cursor_t cursor(&recorder);
+    assert(cursor.slot() == 0);
+
+    /* The master forks inside a scope, the workers continue in their own slots */
+    cursor.begin_scope("serve");
+    cursor.cnt() += 1;
+
+    const int workers = 4;
+    for (int w = 0; w < workers; w++) {
+        if (fork() == 0) {
+            assert(cursor.slot() != 0);
+            for (int i = 0; i < 100; i++) {
+                /* Labels built at runtime are copied into the shared region */
+                std::string name = "request" + std::to_string(i % 2);
+                cursor.begin_scope(name.c_str());
+                cursor.cnt() += 1;
+                cursor.end_scope();
+            }
+            cursor.cnt() += 10;
+            _exit(0);
+        }
+    }
+    for (int w = 0; w < workers; w++) {
+        int status;
+        wait(&status);
+        assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    }
+    cursor.end_scope();
+
+    /* Workers that exited before the next fork leave their slot to it */
+    assert(recorder.slot_count() >= 2 && recorder.slot_count() <= 1 + workers);
+    assert(recorder.node_count() == 4);
+    std::string stacks = collapsed(recorder);
+    assert(stacks.find("root;serve 41\n") != std::string::npos);
+    assert(stacks.find("root;serve;request0 200\n") != std::string::npos);
+    assert(stacks.find("root;serve;request1 200\n") != std::string::npos);
+
+    /* Scopes that don't fit are accounted to the parent */
+    shared_recorder_t<int, uint64_t> small(0, 0, 2, 1);
+    shared_recorder_t<int, uint64_t>::cursor_t small_cursor(&small);
+    small_cursor.begin_scope(1);
+    small_cursor.begin_scope(2);
+    small_cursor.cnt() += 5;
+    small_cursor.end_scope();
+    small_cursor.end_scope();
+    assert(small.dropped() == 1);
+
+    recorder_t<int, uint64_t> combined(0, 0, 0);
+    small.to_recorder(combined);
+    std::ostringstream out;
+    combined.to_collapsed_stacks(out, [] (std::ostream& os, const int& l) { os << l; },
+                                      [] (std::ostream& os, const uint64_t& m) { os << m; });
+    assert(out.str() == "0 0\n0;1 5\n");
+
+    /* Cursors beyond the slots record nothing, they never share a slot */
+    shared_recorder_t<int, uint64_t> few(0, 0, 16, 2);
+    {
+        shared_recorder_t<int, uint64_t>::cursor_t first(&few);
+        std::unique_ptr<shared_recorder_t<int, uint64_t>::cursor_t> second(new shared_recorder_t<int, uint64_t>::cursor_t(&few));
+        shared_recorder_t<int, uint64_t>::cursor_t third(&few);
+        assert(first.has_slot() && second->has_slot() && !third.has_slot());
+        third.begin_scope(3);
+        third.cnt() += 100;
+        third.end_scope();
+        assert(few.dropped() == 1);
+
+        /* A destroyed cursor releases its slot */
+        uint32_t released = second->slot();
+        second.reset();
+        shared_recorder_t<int, uint64_t>::cursor_t fourth(&few);
+        assert(fourth.has_slot() && fourth.slot() == released);
+        fourth.begin_scope(4);
+        fourth.cnt() += 1;
+        fourth.end_scope();
+
+        /* Recycled workers take the slots of the exited ones */
+        for (int w = 0; w < 5; w++) {
+            if (fork() == 0) {
+                /* Both slots are taken by the master until its cursors are gone */
+                assert(!first.has_slot());
+                _exit(0);
+            }
+            int status;
+            wait(&status);
+            assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+        }
+    }
+    for (int w = 0; w < 5; w++) {
+        if (fork() == 0) {
+            shared_recorder_t<int, uint64_t>::cursor_t worker(&few);
+            shared_recorder_t<int, uint64_t>::cursor_t helper(&few);
+            assert(worker.has_slot() && helper.has_slot());
+            worker.begin_scope(5);
+            worker.cnt() += 1;
+            worker.end_scope();
+            /* The worker exits without destroying its cursors */
+            _exit(0);
+        }
+        int status;
+        wait(&status);
+        assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    }
+    assert(few.slot_count() == 2);
+    assert(few.dropped() == 1);
+    recorder_t<int, uint64_t> few_combined(0, 0, 0);
+    few.to_recorder(few_combined);
+    std::ostringstream few_out;
+    few_combined.to_collapsed_stacks(few_out, [] (std::ostream& os, const int& l) { os << l; },
+                                              [] (std::ostream& os, const uint64_t& m) { os << m; });
+    assert(few_out.str() == "0 0\n0;5 5\n0;4 1\n");
+
+    return 0;
+}
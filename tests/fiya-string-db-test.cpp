@@ -1,5 +1,7 @@
 #include "fiya-string-db.h"
 #include <cassert>
+#include <string>
+#include <vector>
 
 using namespace fiya;
 
@@ -13,4 +15,16 @@ int main(int argc, char ** argv) {
     assert(strcmp(string_db.get(idx_dog), "dog") == 0);
     assert(strcmp(string_db.get(idx_cat), "cat") == 0);
 
+    /* Growing the database keeps the strings and their indexes */
+    std::vector<size_t> indexes;
+    for (int i = 0; i < 1000; i++) {
+        indexes.push_back(string_db.push_back(("function_" + std::to_string(i)).c_str()));
+    }
+    for (int i = 0; i < 1000; i++) {
+        std::string name = "function_" + std::to_string(i);
+        assert(strcmp(string_db.get(indexes[i]), name.c_str()) == 0);
+        assert(string_db.push_back(name.c_str()) == indexes[i]);
+    }
+    assert(strcmp(string_db.get(idx_dog), "dog") == 0);
+
 }
\ No newline at end of file
@@ -0,0 +1,88 @@
+#include "../benchmarks/fiya-synthetic-tree.h"
+#include <cassert>
+#include <cmath>
+#include <map>
+
+using namespace fiya;
+using namespace fiya_bench;
+
+/** Generates a tree and returns the number of nodes per depth, the root is depth 0 */
+std::vector<size_t> measure(const tree_options_t& options, size_t& max_children) {
+    recorder_t<int, uint64_t> recorder(0ULL, 0, 0ULL);
+    size_t created = synthetic_tree_generator_t<int, uint64_t>(options).generate(recorder);
+    std::vector<size_t> histogram(options.max_depth + 1);
+    std::map<std::vector<int>, size_t> children;
+    recorder.for_each_path([&] (const std::vector<int>& path, const uint64_t&) {
+        histogram[path.size() - 1]++;
+        if (path.size() > 2) {
+            children[std::vector<int>(path.begin(), path.end() - 1)]++;
+        }
+    });
+    max_children = 0;
+    for (auto& entry : children) {
+        max_children = std::max(max_children, entry.second);
+    }
+    size_t total = 0;
+    for (size_t d = 1; d < histogram.size(); d++) {
+        total += histogram[d];
+    }
+    assert(total == created);
+    return histogram;
+}
+
+int main(int argc, char ** argv) {
+    /* The depths follow the geometric distribution */
+    for (double p : { 0.3, 0.6, 0.9 }) {
+        tree_options_t options;
+        options.node_count = 5000;
+        options.root_fanout = 5000;
+        options.max_depth = 12;
+        options.descend_probability = p;
+
+        size_t max_children;
+        std::vector<size_t> histogram = measure(options, max_children);
+        std::vector<size_t> expected = depth_histogram(options);
+        double sum = (1.0 - std::pow(p, 12)) / (1.0 - p);
+        assert(histogram[0] == 1);
+        for (size_t d = 1; d <= options.max_depth; d++) {
+            assert(histogram[d] == expected[d - 1]);
+            double share = options.node_count * std::pow(p, static_cast<double>(d - 1)) / sum;
+            assert(std::fabs(static_cast<double>(histogram[d]) - share) <= 1.0);
+        }
+        assert(max_children <= options.fanout);
+    }
+
+    /* Lower ratios give shallower trees */
+    tree_options_t shallow, deep;
+    shallow.descend_probability = 0.3;
+    deep.descend_probability = 0.6;
+    size_t max_children;
+    std::vector<size_t> shallow_histogram = measure(shallow, max_children);
+    assert(max_children <= shallow.fanout);
+    std::vector<size_t> deep_histogram = measure(deep, max_children);
+    assert(max_children <= deep.fanout);
+    assert(shallow_histogram[1] == shallow.root_fanout);
+    assert(shallow_histogram[32] == 0);
+    double shallow_mean = 0, deep_mean = 0;
+    for (size_t d = 1; d <= 32; d++) {
+        shallow_mean += static_cast<double>(d * shallow_histogram[d]) / static_cast<double>(shallow.node_count);
+        deep_mean += static_cast<double>(d * deep_histogram[d]) / static_cast<double>(deep.node_count);
+    }
+    assert(shallow_mean < deep_mean);
+
+    /* Nodes that don't fit into the fanouts are not created */
+    tree_options_t narrow;
+    narrow.node_count = 100;
+    narrow.fanout = 1;
+    narrow.root_fanout = 2;
+    narrow.max_depth = 10;
+    std::vector<size_t> narrow_histogram = measure(narrow, max_children);
+    size_t created = 0;
+    for (size_t d = 1; d <= 10; d++) {
+        assert(narrow_histogram[d] == 2);
+        created += narrow_histogram[d];
+    }
+    assert(created == 20);
+
+    return 0;
+}
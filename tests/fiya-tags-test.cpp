@@ -0,0 +1,68 @@
+#include "../fiya-tags.h"
+#include <cassert>
+#include <sstream>
+#include <string>
+
+using namespace fiya;
+
+using my_recorder_t = tagged_recorder_t<int, uint64_t>;
+
+/** Records @value in the scope @label of the current tag */
+void record(my_recorder_t& recorder, int label, uint64_t value) {
+    recorder.recorder()->begin_scope(label);
+    recorder.recorder()->cnt() += value;
+    recorder.recorder()->end_scope();
+}
+
+int main(int argc, char ** argv) {
+    tag_registry_t registry(2);
+    tag_id_t tenant_a = registry.register_tag("tenant_a");
+    tag_id_t tenant_b = registry.register_tag("tenant_b");
+
+    /* Over the limit, new tags become the overflow tag */
+    assert(registry.register_tag("tenant_c") == overflow_tag);
+    assert(registry.register_tag("tenant_d") == overflow_tag);
+    assert(registry.register_tag("tenant_a") == tenant_a);
+    assert(registry.size() == 4);
+    assert(registry.name(tenant_b) == "tenant_b");
+    assert(registry.name(overflow_tag) == "other");
+
+    my_recorder_t r1(&registry, 0ULL, 0, 0ULL);
+    record(r1, 1, 1);
+    {
+        tag_scope_t<int, uint64_t> tag(&r1, tenant_a);
+        record(r1, 1, 10);
+        record(r1, 2, 20);
+    }
+    assert(r1.tag() == untagged_tag);
+    {
+        tag_scope_t<int, uint64_t> tag(&r1, registry.register_tag("tenant_c"));
+        record(r1, 1, 100);
+    }
+    assert(r1.recorder(tenant_b) == nullptr);
+
+    /* Merging another thread's recorder, tag by tag */
+    my_recorder_t r2(&registry, 0ULL, 0, 0ULL);
+    r2.set_tag(tenant_b);
+    record(r2, 3, 1000);
+    r2.set_tag(tenant_a);
+    record(r2, 1, 10);
+    r1.merge(r2);
+
+    auto label_out = [] (std::ostream& os, const int& l) { os << l; };
+    auto value_out = [] (std::ostream& os, const uint64_t& m) { os << m; };
+
+    std::ostringstream tenant_a_out;
+    r1.to_collapsed_stacks(tenant_a, tenant_a_out, label_out, value_out);
+    assert(tenant_a_out.str() == "0 0\n0;1 20\n0;2 20\n");
+
+    std::ostringstream combined;
+    r1.to_collapsed_stacks(combined, label_out, value_out);
+    assert(combined.str() ==
+        "untagged;0 0\nuntagged;0;1 1\n"
+        "other;0 0\nother;0;1 100\n"
+        "tenant_a;0 0\ntenant_a;0;1 20\ntenant_a;0;2 20\n"
+        "tenant_b;0 0\ntenant_b;0;3 1000\n");
+
+    return 0;
+}
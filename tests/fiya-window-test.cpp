@@ -0,0 +1,81 @@
+#include "../fiya-window.h"
+#include <cassert>
+#include <map>
+#include <string>
+#include <thread>
+
+using namespace fiya;
+
+using my_window_t = window_recorder_t<int, uint64_t, 3>;
+
+/** Records @value in the scope given by the labels */
+void record(my_window_t& recorder, std::initializer_list<int> labels, uint64_t value) {
+    for (int l: labels) {
+        recorder.begin_scope(l);
+    }
+    recorder.cnt() += value;
+    for (size_t i = 0; i < labels.size(); i++) {
+        recorder.end_scope();
+    }
+}
+
+/** Returns the sums of the last @last_n intervals as path -> value */
+std::map<std::string, uint64_t> to_map(my_window_t& recorder, size_t last_n) {
+    std::map<std::string, uint64_t> result;
+    recorder.for_each_path(last_n, [&] (const std::vector<int>& path, const uint64_t& value) {
+        std::string key;
+        for (int l: path) {
+            key += key.empty() ? std::to_string(l) : ";" + std::to_string(l);
+        }
+        result[key] = value;
+    });
+    return result;
+}
+
+int main(int argc, char ** argv) {
+    my_window_t recorder(0ULL, 0, 0ULL);
+
+    record(recorder, { 1, 2 }, 1);
+    assert(recorder.intervals() == 1);
+    recorder.advance();
+    record(recorder, { 1, 2 }, 10);
+    record(recorder, { 3 }, 20);
+    recorder.advance();
+    record(recorder, { 1, 2 }, 100);
+    assert(recorder.intervals() == 3);
+
+    assert(to_map(recorder, 1)["0;1;2"] == 100);
+    assert(to_map(recorder, 1)["0;3"] == 0);
+    assert(to_map(recorder, 2)["0;1;2"] == 110);
+    assert(to_map(recorder, 2)["0;3"] == 20);
+    assert(to_map(recorder, 3)["0;1;2"] == 111);
+    assert(to_map(recorder, 10)["0;1;2"] == 111);
+
+    /* The oldest interval is dropped, the tree shape is kept */
+    recorder.advance();
+    assert(recorder.intervals() == 3);
+    std::map<std::string, uint64_t> window = to_map(recorder, 3);
+    assert(window.size() == 4);
+    assert(window["0;1;2"] == 110);
+    assert(window["0;3"] == 20);
+    assert(to_map(recorder, 1)["0;1;2"] == 0);
+
+    /* An open scope continues in the next interval */
+    recorder.begin_scope(1);
+    recorder.cnt() += 5;
+    recorder.advance();
+    recorder.cnt() += 7;
+    recorder.end_scope();
+    assert(to_map(recorder, 1)["0;1"] == 7);
+    assert(to_map(recorder, 2)["0;1"] == 12);
+
+    /* Late calls don't shift the following intervals */
+    my_window_t timed(0, 0, 0, std::chrono::milliseconds(100));
+    std::this_thread::sleep_for(std::chrono::milliseconds(250));
+    assert(timed.advance_if_due() == 2);
+    std::this_thread::sleep_for(std::chrono::milliseconds(60));
+    assert(timed.advance_if_due() == 1);
+    assert(timed.intervals() == 3);
+
+    return 0;
+}
@@ -0,0 +1,2 @@
+g++ -O3 -pthread fiya-merge.cpp -o fiya-merge
+g++ -O3 fiya-collector.cpp -o fiya-collector
@@ -0,0 +1,94 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+
+#include <poll.h>
+
+#include "../fiya-collector.h"
+
+/** Collector of profile deltas sent by delta_exporter_t. Merges them per
+ *  binary and tag and writes the aggregated profiles periodically, and
+ *  on SIGINT or SIGTERM, in the collapsed stack format.
+ *
+ *  Usage: fiya-collector [--socket PATH] [--output DIR] [--interval SECONDS]
+ */
+
+using namespace fiya;
+
+static volatile std::sig_atomic_t stop_requested = 0;
+
+static void on_signal(int) {
+    stop_requested = 1;
+}
+
+int main(int argc, char **argv) {
+    std::string socket_path { "/tmp/fiya-collector.sock" };
+    std::string output { "." };
+    int interval { 10 };
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--socket") == 0 && i + 1 < argc) {
+            socket_path = argv[++i];
+        } else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            output = argv[++i];
+        } else if (strcmp(argv[i], "--interval") == 0 && i + 1 < argc) {
+            interval = std::max(1, atoi(argv[++i]));
+        } else {
+            std::cerr << "Usage: fiya-collector [--socket PATH] [--output DIR] [--interval SECONDS]\n";
+            return 1;
+        }
+    }
+
+    int fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+    unlink(socket_path.c_str());
+    if (fd < 0 || bind(fd, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) != 0) {
+        std::cerr << "Couldn't bind " << socket_path << ": " << strerror(errno) << "\n";
+        return 1;
+    }
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    delta_collector_t collector;
+    std::vector<char> buffer(1U << 20);
+    uint64_t datagrams { 0U };
+    uint64_t malformed { 0U };
+    auto next_write = std::chrono::steady_clock::now() + std::chrono::seconds(interval);
+
+    while (!stop_requested) {
+        auto now = std::chrono::steady_clock::now();
+        if (now >= next_write) {
+            if (!collector.write(output)) {
+                std::cerr << "Couldn't write the profiles to " << output << "\n";
+            }
+            next_write = now + std::chrono::seconds(interval);
+        }
+
+        struct pollfd pfd { fd, POLLIN, 0 };
+        int timeout = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(next_write - now).count());
+        if (poll(&pfd, 1, timeout) <= 0) {
+            continue;
+        }
+        ssize_t size = recv(fd, buffer.data(), buffer.size(), 0);
+        if (size > 0) {
+            datagrams++;
+            if (!collector.add_datagram(buffer.data(), static_cast<size_t>(size))) {
+                malformed++;
+            }
+        }
+    }
+
+    collector.write(output);
+    close(fd);
+    unlink(socket_path.c_str());
+    std::cerr << "Received " << datagrams << " datagrams, " << malformed << " malformed\n";
+    return 0;
+}
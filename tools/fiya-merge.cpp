@@ -0,0 +1,85 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+
+#include "../fiya-collapsed.h"
+
+/** Merges collapsed stack files, e.g. of many hosts, into one profile.
+ *
+ *  Usage: fiya-merge [--threads N] [--format collapsed|report]
+ *                    [--no-root-frame] [--list FILE] [--output FILE] [FILE...]
+ *
+ *  --list reads the file names from FILE, one per line, for more files
+ *  than fit on the command line. The report format writes one line per
+ *  label with its self and total value, separated by tabs.
+ */
+
+using namespace fiya;
+
+int main(int argc, char **argv) {
+    std::vector<std::string> paths;
+    size_t threads { 0U };
+    std::string format { "collapsed" };
+    const char * output { nullptr };
+    collapsed_parse_options_t options;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = static_cast<size_t>(atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+            format = argv[++i];
+        } else if (strcmp(argv[i], "--no-root-frame") == 0) {
+            options.root_frame = false;
+        } else if (strcmp(argv[i], "--list") == 0 && i + 1 < argc) {
+            std::ifstream list(argv[++i]);
+            std::string path;
+            while (std::getline(list, path)) {
+                if (!path.empty()) {
+                    paths.push_back(path);
+                }
+            }
+        } else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            output = argv[++i];
+        } else {
+            paths.push_back(argv[i]);
+        }
+    }
+
+    if (paths.empty() || (format != "collapsed" && format != "report")) {
+        std::cerr << "Usage: fiya-merge [--threads N] [--format collapsed|report] "
+                     "[--no-root-frame] [--list FILE] [--output FILE] [FILE...]\n";
+        return 1;
+    }
+
+    recorder_t<const char*, uint64_t> merged(0U, "root", 0U);
+    collapsed_parse_result_t result = merge_collapsed_files(paths, merged, threads, options);
+    std::cerr << "Merged " << result.lines << " stacks from " << paths.size() - result.failed_files << " files";
+    if (result.malformed > 0) {
+        std::cerr << ", skipped " << result.malformed << " malformed lines";
+    }
+    std::cerr << "\n";
+    if (result.failed_files > 0) {
+        std::cerr << "Couldn't read " << result.failed_files << " files\n";
+    }
+
+    std::ofstream file;
+    if (output != nullptr) {
+        file.open(output);
+    }
+    std::ostream& os = output != nullptr ? file : std::cout;
+
+    if (format == "collapsed") {
+        merged.to_collapsed_stacks(os,
+            [] (std::ostream& os, const char* const & l) { os << l; },
+            [] (std::ostream& os, const uint64_t& m) { os << m; });
+    } else {
+        auto report = merged.to_report();
+        for (const auto& v: report.report) {
+            os << v.first << "\t" << v.second.self << "\t" << v.second.total << "\n";
+        }
+    }
+    return result.failed_files > 0 ? 2 : 0;
+}